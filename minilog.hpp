@@ -55,6 +55,8 @@ NS_MINILOG_BEGIN
     f(error) \
     f(fatal)
 
+using clock_function = std::chrono::system_clock::time_point (*)();
+
 enum class log_level : uint8_t {
 #define _ENUMERATE_LOG_LEVEL(level) level,
     MINILOG_FOREACH_LOG_LEVEL(_ENUMERATE_LOG_LEVEL)
@@ -90,8 +92,10 @@ namespace details {
         return std::ofstream();
         }();
 
+    inline clock_function g_clock = []() { return std::chrono::system_clock::now(); };
+
     inline void output_log(log_level level, std::string msg, std::source_location location) {
-        std::chrono::zoned_time now(std::chrono::current_zone(), std::chrono::high_resolution_clock::now());
+        std::chrono::zoned_time now(std::chrono::current_zone(), g_clock());
         msg = std::format("{} {}:{} [{}] {}", now, location.file_name(), location.line(),
             to_string(level), msg);
         if (level >= g_log_level_threshold) {
@@ -133,6 +137,18 @@ inline void set_log_file(const std::string& filename) {
     details::g_log_file.open(filename, std::ios::app);
 }
 
+/**
+ * @brief Sets the clock used to timestamp log messages.
+ *
+ * The default clock is std::chrono::system_clock. Tests can pass a function
+ * returning a fixed time to get reproducible output.
+ *
+ * @param clock The function returning the current time.
+ */
+inline void set_clock(clock_function clock) {
+    details::g_clock = clock;
+}
+
 /**
  * @brief Logs a formatted message with a specified log level.
  *
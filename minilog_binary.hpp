@@ -0,0 +1,620 @@
+#pragma once
+
+#include <minilog_v2.hpp>
+
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace minilog {
+
+// Compact binary encoding of records. A stream starts with a zero byte and its header, and continues with entries,
+// each preceded by its size as a varint. The header holds what is needed to read the stream without the program that
+// wrote it (see FileHeader):
+//   "MLOG" | varint(version) | zigzag(anchor time) | varint(cycle counter at the anchor) | cycle counter frequency
+//   | zigzag(UTC offset) | varint(process id) | string(host name)
+// An entry describes a call site the first time one of its records is written to the stream:
+//   varint(call site id << 3 | DEFINITION) | varint(level) | varint(line) | string(file) | string(function)
+//   | string(format) | string(signature)
+// or holds a record:
+//   varint(call site id << 3 | flags) | zigzag(time - time of the previous record) | [trace context] | message
+// Times are nanoseconds since the epoch, and the first record is relative to the anchor time of the header. Strings
+// are a varint length and the bytes. The trace context is three little-endian 64-bit words. The message is either
+// text, with the TEXT flag, or the raw arguments in the order of the signature of the call site (see RawCodec):
+// integers as varints, signed ones zigzag-encoded, bools and chars as one byte, floats and doubles as their
+// little-endian bits. Decoders skip fields added to the header by later versions.
+namespace binary {
+inline constexpr std::uint32_t VERSION = 1;
+inline constexpr std::string_view MAGIC = "MLOG";
+
+inline constexpr unsigned TRACE = 1 << 0;      // A trace context follows the time.
+inline constexpr unsigned TEXT = 1 << 1;       // The message is stored as text: its arguments were not kept raw.
+inline constexpr unsigned DEFINITION = 1 << 2; // The entry describes a call site.
+inline constexpr unsigned FLAG_BITS = 3;
+
+// Metadata written once at the start of a stream.
+struct FileHeader {
+    std::uint32_t version = VERSION;
+    std::chrono::sys_time<std::chrono::nanoseconds> anchor; // When the stream was started.
+    std::uint64_t tsc = 0;              // Cycle counter at the anchor time, or 0 without a cycle counter.
+    double tsc_frequency = 0;           // Ticks of the cycle counter per second, or 0 without a cycle counter.
+    std::int64_t utc_offset = 0;        // Offset of the local time zone from UTC, in seconds.
+    std::uint64_t pid = 0;
+    std::string host;
+};
+
+inline void put_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Signed values are zigzag-encoded first, so that small negative values stay short.
+inline void put_zigzag(std::string& out, std::int64_t value) {
+    put_varint(out, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+// Little-endian value of the given number of bytes.
+inline void put_fixed(std::string& out, std::uint64_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Take a varint off the front of the data. Returns false if it is truncated or longer than 64 bits.
+inline bool get_varint(std::string_view& in, std::uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        auto byte = static_cast<unsigned char>(in.front());
+        in.remove_prefix(1);
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool get_zigzag(std::string_view& in, std::int64_t& value) {
+    std::uint64_t encoded;
+    if (!get_varint(in, encoded)) {
+        return false;
+    }
+    value = static_cast<std::int64_t>((encoded >> 1) ^ (~(encoded & 1) + 1));
+    return true;
+}
+
+inline bool get_fixed(std::string_view& in, std::uint64_t& value, std::size_t bytes) {
+    if (in.size() < bytes) {
+        return false;
+    }
+    value = 0;
+    for (std::size_t i = bytes; i-- > 0;) {
+        value = value << 8 | static_cast<unsigned char>(in[i]);
+    }
+    in.remove_prefix(bytes);
+    return true;
+}
+
+inline void put_string(std::string& out, std::string_view value) {
+    put_varint(out, value.size());
+    out += value;
+}
+
+inline bool get_string(std::string_view& in, std::string_view& value) {
+    std::uint64_t length;
+    if (!get_varint(in, length) || length > in.size()) {
+        return false;
+    }
+    value = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+// Header of a stream for the running process, anchored at the current time. Measures the rate of the cycle counter
+// on first use.
+inline FileHeader local_header() {
+    FileHeader header;
+    if constexpr (TscClock::available) {
+        const minilog::details::TscRate& rate = minilog::details::tsc_rate();
+        header.tsc = TscClock::now();
+        header.tsc_frequency = 1e9 / rate.ns_per_tick;
+    }
+    header.anchor = std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now());
+    header.utc_offset = minilog::details::local_utc_offset();
+    header.pid = static_cast<std::uint64_t>(::getpid());
+    char host[256] = {};
+    if (::gethostname(host, sizeof(host) - 1) == 0) {
+        header.host = host;
+    }
+    return header;
+}
+
+namespace details {
+template<typename T>
+T load(const std::byte* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+inline std::int64_t load_signed(const std::byte* data, std::size_t size) {
+    switch (size) {
+    case 1: return load<std::int8_t>(data);
+    case 2: return load<std::int16_t>(data);
+    case 4: return load<std::int32_t>(data);
+    default: return load<std::int64_t>(data);
+    }
+}
+
+inline std::uint64_t load_unsigned(const std::byte* data, std::size_t size) {
+    switch (size) {
+    case 1: return load<std::uint8_t>(data);
+    case 2: return load<std::uint16_t>(data);
+    case 4: return load<std::uint32_t>(data);
+    default: return load<std::uint64_t>(data);
+    }
+}
+} // namespace details
+
+// Encode raw arguments, stored one after the other as described by the signature.
+inline void encode_arguments(std::string& out, std::string_view signature, const std::byte* data) {
+    for (char code : signature) {
+        std::size_t size = minilog::details::raw_type_size(code);
+        switch (code) {
+        case '?':
+        case 'c': out.push_back(static_cast<char>(details::load<unsigned char>(data))); break;
+        case 'b':
+        case 'h':
+        case 'i':
+        case 'q': put_zigzag(out, details::load_signed(data, size)); break;
+        case 'B':
+        case 'H':
+        case 'I':
+        case 'Q': put_varint(out, details::load_unsigned(data, size)); break;
+        case 'f': put_fixed(out, std::bit_cast<std::uint32_t>(details::load<float>(data)), 4); break;
+        case 'd': put_fixed(out, std::bit_cast<std::uint64_t>(details::load<double>(data)), 8); break;
+        default: // Long doubles are narrowed to doubles.
+            put_fixed(out, std::bit_cast<std::uint64_t>(static_cast<double>(details::load<long double>(data))), 8);
+        }
+        data += size;
+    }
+}
+
+// Encoder of a stream. It keeps the time of the previous record, which the time of the next one is relative to, and
+// the call sites already described in the stream.
+class Encoder {
+public:
+    // Append the start of a new stream with its header.
+    void start(std::string& out, const FileHeader& header) {
+        record_.clear();
+        record_ += MAGIC;
+        put_varint(record_, header.version);
+        put_zigzag(record_, header.anchor.time_since_epoch().count());
+        put_varint(record_, header.tsc);
+        put_fixed(record_, std::bit_cast<std::uint64_t>(header.tsc_frequency), 8);
+        put_zigzag(record_, header.utc_offset);
+        put_varint(record_, header.pid);
+        put_string(record_, header.host);
+        out.push_back('\0');
+        put_varint(out, record_.size());
+        out += record_;
+        previous_time_ = header.anchor.time_since_epoch().count();
+        defined_.clear();
+    }
+
+    // Append a record, preceded by the description of its call site if it is the first record of the call site in the
+    // stream. The call site must have been registered, which the logger does before passing records to sinks.
+    void encode(std::string& out, const LogMessage& message) {
+        const CallSite& site = *message.site;
+        if (site.id >= defined_.size() || !defined_[site.id]) {
+            __define(out, site, message.codec != nullptr ? message.codec->signature : std::string_view());
+        }
+        record_.clear();
+        unsigned flags = (message.trace != nullptr ? TRACE : 0) |
+                         (message.codec == nullptr && !message.literal ? TEXT : 0);
+        put_varint(record_, std::uint64_t(message.site->id) << FLAG_BITS | flags);
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(message.time.time_since_epoch()).count();
+        put_zigzag(record_, time - previous_time_);
+        previous_time_ = time;
+        if (message.trace != nullptr) {
+            put_fixed(record_, message.trace->trace_id_high, 8);
+            put_fixed(record_, message.trace->trace_id_low, 8);
+            put_fixed(record_, message.trace->span_id, 8);
+        }
+        if (flags & TEXT) {
+            put_varint(record_, message.message.size());
+            record_ += message.message;
+        } else if (message.codec != nullptr) {
+            encode_arguments(record_, message.codec->signature, message.args);
+        }
+        put_varint(out, record_.size());
+        out += record_;
+    }
+
+private:
+    void __define(std::string& out, const CallSite& site, std::string_view signature) {
+        if (site.id >= defined_.size()) {
+            defined_.resize(site.id + 1);
+        }
+        defined_[site.id] = true;
+        record_.clear();
+        put_varint(record_, std::uint64_t(site.id) << FLAG_BITS | DEFINITION);
+        put_varint(record_, static_cast<std::uint64_t>(site.level));
+        put_varint(record_, site.location.line());
+        put_string(record_, site.location.file_name());
+        put_string(record_, site.location.function_name());
+        put_string(record_, site.format);
+        put_string(record_, signature);
+        put_varint(out, record_.size());
+        out += record_;
+    }
+
+    std::int64_t previous_time_ = 0;
+    std::vector<bool> defined_; // By call site id.
+    std::string record_;
+};
+
+// Value of a decoded argument.
+using Argument = std::variant<bool, char, std::int64_t, std::uint64_t, float, double>;
+
+// What a decoder needs to know about a call site.
+struct SiteDescription {
+    LogLevel level;
+    std::string format;
+    std::string file;
+    std::uint32_t line;
+    std::string signature; // Types of the raw arguments, as in RawCodec.
+    std::string function;
+};
+
+// A decoded record. The text views the decoded data.
+struct DecodedRecord {
+    std::uint32_t site;
+    std::chrono::sys_time<std::chrono::nanoseconds> time;
+    std::optional<TraceContext> trace;
+    std::optional<std::string_view> text; // The message, if it was stored as text.
+    std::vector<Argument> arguments;      // Otherwise, the arguments of the format string of the call site.
+};
+
+// Format a message from a format string and decoded arguments. Every replacement field is formatted on its own, so
+// nested replacement fields such as "{:{}}" are not supported.
+inline void format_message(std::string& out, std::string_view format, std::span<const Argument> arguments) {
+    std::size_t next_argument = 0;
+    std::string field;
+    for (std::size_t i = 0; i < format.size(); ++i) {
+        char c = format[i];
+        if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+            out.push_back(c);
+            ++i;
+            continue;
+        }
+        std::size_t close = c == '{' ? format.find('}', i) : std::string_view::npos;
+        if (close == std::string_view::npos) {
+            out.push_back(c);
+            continue;
+        }
+        std::string_view spec = format.substr(i + 1, close - i - 1);
+        std::size_t colon = spec.find(':');
+        std::string_view id = spec.substr(0, colon);
+        std::size_t index = next_argument++;
+        if (!id.empty()) {
+            std::from_chars(id.data(), id.data() + id.size(), index);
+        }
+        if (index >= arguments.size()) {
+            throw std::runtime_error("Missing argument in binary log record");
+        }
+        field = '{';
+        if (colon != std::string_view::npos) {
+            field += spec.substr(colon);
+        }
+        field += '}';
+        std::visit(
+            [&](auto value) { std::vformat_to(std::back_inserter(out), field, std::make_format_args(value)); },
+            arguments[index]);
+        i = close;
+    }
+}
+
+// Decoder of streams, the counterpart of Encoder. The call sites are described in the streams; define() is only needed
+// for call sites written elsewhere.
+class Decoder {
+public:
+    // Header of the current stream.
+    const FileHeader& header() const {
+        return header_;
+    }
+
+    // Describe the call site with the given id.
+    void define(std::uint32_t id, SiteDescription site) {
+        if (id >= sites_.size()) {
+            sites_.resize(id + 1);
+        }
+        sites_[id] = std::move(site);
+    }
+
+    // Get the description of a call site, or nullptr if it is not defined.
+    const SiteDescription* site(std::uint32_t id) const {
+        return id < sites_.size() && sites_[id] ? &*sites_[id] : nullptr;
+    }
+
+    // Decode the next record at the front of the data and take it off, reading the stream headers and call site
+    // descriptions on the way. Returns false at the end of the data, and throws if an entry is malformed or a record
+    // refers to a call site that has not been described.
+    bool next(std::string_view& data, DecodedRecord& record) {
+        while (!data.empty()) {
+            bool stream_start = data.front() == '\0';
+            if (stream_start) {
+                data.remove_prefix(1);
+            }
+            std::uint64_t size;
+            if (!get_varint(data, size) || size > data.size()) {
+                throw std::runtime_error("Truncated binary log entry");
+            }
+            std::string_view in = data.substr(0, size);
+            data.remove_prefix(size);
+            std::uint64_t tag;
+            if (stream_start) {
+                __start(in);
+            } else if (!get_varint(in, tag)) {
+                throw std::runtime_error("Malformed binary log entry");
+            } else if (tag & DEFINITION) {
+                __define(static_cast<std::uint32_t>(tag >> FLAG_BITS), in);
+            } else {
+                __decode(tag, in, record);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Format the message of a decoded record.
+    std::string message(const DecodedRecord& record) const {
+        if (record.text) {
+            return std::string(*record.text);
+        }
+        std::string out;
+        format_message(out, site(record.site)->format, record.arguments);
+        return out;
+    }
+
+    // Render a decoded record like FileSink does, in the local time of the process that wrote it.
+    std::string line(const DecodedRecord& record) const {
+        const SiteDescription& description = *site(record.site);
+        // UTC time shifted by the offset, so that it reads as the local time. Kept at the precision of the system clock
+        // so that %S prints the same fractional seconds as FileSink.
+        auto local = std::chrono::floor<std::chrono::system_clock::duration>(record.time) +
+                     std::chrono::seconds(header_.utc_offset);
+        std::string out = std::format("{:%Y/%m/%d %H:%M:%S} [{}] [{}:{}] ", local, to_string(description.level),
+                                      description.file, description.line);
+        if (record.trace) {
+            std::format_to(std::back_inserter(out), "[{:016x}{:016x}:{:016x}] ", record.trace->trace_id_high,
+                           record.trace->trace_id_low, record.trace->span_id);
+        }
+        out += message(record);
+        return out;
+    }
+
+private:
+    void __start(std::string_view in) {
+        std::uint64_t version;
+        std::int64_t anchor;
+        std::uint64_t frequency;
+        std::string_view host;
+        if (!in.starts_with(MAGIC)) {
+            throw std::runtime_error("Not a binary log stream");
+        }
+        in.remove_prefix(MAGIC.size());
+        if (!get_varint(in, version) || !get_zigzag(in, anchor) || !get_varint(in, header_.tsc) ||
+            !get_fixed(in, frequency, 8) || !get_zigzag(in, header_.utc_offset) || !get_varint(in, header_.pid) ||
+            !get_string(in, host)) {
+            throw std::runtime_error("Malformed binary log header");
+        }
+        if (version > VERSION) {
+            throw std::runtime_error("Unsupported binary log version");
+        }
+        header_.version = static_cast<std::uint32_t>(version);
+        header_.anchor = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(anchor));
+        header_.tsc_frequency = std::bit_cast<double>(frequency);
+        header_.host = host;
+        previous_time_ = anchor;
+        sites_.clear(); // Call site ids are only valid within a stream.
+    }
+
+    void __define(std::uint32_t id, std::string_view in) {
+        std::uint64_t level;
+        std::uint64_t line;
+        std::string_view file, function, format, signature;
+        if (!get_varint(in, level) || !get_varint(in, line) || !get_string(in, file) || !get_string(in, function) ||
+            !get_string(in, format) || !get_string(in, signature)) {
+            throw std::runtime_error("Malformed binary log call site");
+        }
+        define(id, {static_cast<LogLevel>(level), std::string(format), std::string(file),
+                    static_cast<std::uint32_t>(line), std::string(signature), std::string(function)});
+    }
+
+    void __decode(std::uint64_t header, std::string_view in, DecodedRecord& record) {
+        std::int64_t delta;
+        if (!get_zigzag(in, delta)) {
+            throw std::runtime_error("Malformed binary log record");
+        }
+        record.site = static_cast<std::uint32_t>(header >> FLAG_BITS);
+        const SiteDescription* description = site(record.site);
+        if (description == nullptr) {
+            throw std::runtime_error("Binary log record of an unknown call site");
+        }
+        previous_time_ += delta;
+        record.time = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(previous_time_));
+        record.trace.reset();
+        if (header & TRACE) {
+            TraceContext trace;
+            if (!get_fixed(in, trace.trace_id_high, 8) || !get_fixed(in, trace.trace_id_low, 8) ||
+                !get_fixed(in, trace.span_id, 8)) {
+                throw std::runtime_error("Malformed binary log record");
+            }
+            record.trace = trace;
+        }
+        record.text.reset();
+        record.arguments.clear();
+        if (header & TEXT) {
+            std::uint64_t length;
+            if (!get_varint(in, length) || length > in.size()) {
+                throw std::runtime_error("Malformed binary log record");
+            }
+            record.text = in.substr(0, length);
+            return;
+        }
+        for (char code : description->signature) {
+            if (!__decode_argument(in, code, record.arguments)) {
+                throw std::runtime_error("Malformed binary log record");
+            }
+        }
+    }
+
+    static bool __decode_argument(std::string_view& in, char code, std::vector<Argument>& arguments) {
+        std::uint64_t value;
+        std::int64_t signed_value;
+        switch (code) {
+        case '?':
+        case 'c':
+            if (!get_fixed(in, value, 1)) {
+                return false;
+            }
+            arguments.emplace_back(code == '?' ? Argument(value != 0) : Argument(static_cast<char>(value)));
+            return true;
+        case 'b':
+        case 'h':
+        case 'i':
+        case 'q':
+            if (!get_zigzag(in, signed_value)) {
+                return false;
+            }
+            arguments.emplace_back(signed_value);
+            return true;
+        case 'B':
+        case 'H':
+        case 'I':
+        case 'Q':
+            if (!get_varint(in, value)) {
+                return false;
+            }
+            arguments.emplace_back(value);
+            return true;
+        case 'f':
+            if (!get_fixed(in, value, 4)) {
+                return false;
+            }
+            arguments.emplace_back(std::bit_cast<float>(static_cast<std::uint32_t>(value)));
+            return true;
+        default:
+            if (!get_fixed(in, value, 8)) {
+                return false;
+            }
+            arguments.emplace_back(std::bit_cast<double>(value));
+            return true;
+        }
+    }
+
+    FileHeader header_;
+    std::vector<std::optional<SiteDescription>> sites_; // By call site id.
+    std::int64_t previous_time_ = 0;
+};
+} // namespace binary
+
+// Sink writing records in the binary format (see namespace binary) to a file. Statements with only arithmetic
+// arguments keep them raw: they are copied into the queue instead of being formatted, and encoded by this sink.
+// Each opening of the file starts a new stream with its own header and call site descriptions, and so does a change of
+// the UTC offset, e.g. to daylight saving time: every stream has the offset its records are shown in by FileSink.
+// Records are buffered and written when the buffer is full, after every batch of the backend and when the sink is
+// closed.
+class BinaryFileSink {
+public:
+    static constexpr bool raw_arguments = true;
+
+    // Set the number of bytes buffered before they are written. Zero writes every record right away, which a
+    // synchronous logger needs to not lose records in a crash.
+    void set_buffer_size(std::size_t bytes) {
+        buffer_size_ = bytes;
+    }
+
+    void open(const std::string& file_name) {
+        fd_ = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open binary log file");
+        }
+        binary::FileHeader header = binary::local_header();
+        utc_offset_ = header.utc_offset;
+        zone_begin_ = zone_end_ = {};
+        encoder_.start(buffer_, header);
+#if !defined(NDEBUG)
+        std::cout << "Binary log file: " << file_name << std::endl;
+#endif
+    }
+
+    void write(const LogMessage& message) {
+        if (message.time < zone_begin_ || message.time >= zone_end_) {
+            __update_zone(message.time);
+        }
+        encoder_.encode(buffer_, message);
+        if (buffer_.size() >= buffer_size_) {
+            flush();
+        }
+    }
+
+    // Write the buffered records.
+    void flush() {
+        if (!buffer_.empty()) {
+            minilog::details::write_all(fd_, buffer_);
+            buffer_.clear();
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            flush();
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    // Look up the UTC offset of the local time zone at the time of a record, and start a new stream if it changed.
+    void __update_zone(std::chrono::system_clock::time_point time) {
+        std::chrono::sys_info info = std::chrono::current_zone()->get_info(time);
+        zone_begin_ = info.begin;
+        zone_end_ = info.end;
+        if (info.offset.count() != utc_offset_) {
+            binary::FileHeader header = binary::local_header();
+            header.utc_offset = info.offset.count();
+            utc_offset_ = header.utc_offset;
+            encoder_.start(buffer_, header);
+        }
+    }
+
+    int fd_ = -1;
+    std::size_t buffer_size_ = 64 * 1024;
+    binary::Encoder encoder_;
+    std::string buffer_;
+    std::int64_t utc_offset_ = 0;         // UTC offset in the header of the current stream.
+    std::chrono::sys_seconds zone_begin_; // Times with the same UTC offset as the last record.
+    std::chrono::sys_seconds zone_end_;
+};
+
+} // namespace minilog
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <minilog_v2.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define MINILOG_HAS_SSE42_CRC 1
+#else
+#define MINILOG_HAS_SSE42_CRC 0
+#endif
+
+namespace minilog {
+
+// Framing of records in a file, so that a torn write at the end of the file can be detected and cut off, and a reader
+// can skip over damage. A frame is
+//   length (u32, little-endian) | CRC32C of the length and the payload (u32, little-endian) | payload
+// and a sync marker (0xffffffff "MLSY") is written before the first frame that starts in each block of BLOCK_SIZE
+// bytes. Recovery only has to look back to the last sync marker instead of reading the file from the start.
+namespace framing {
+inline constexpr std::size_t BLOCK_SIZE = 32 * 1024;
+inline constexpr std::size_t MAX_RECOVERY_WINDOW = 64 * BLOCK_SIZE;
+inline constexpr std::size_t HEADER_SIZE = 8;
+inline constexpr std::array<unsigned char, 8> SYNC_MARKER = {0xff, 0xff, 0xff, 0xff, 'M', 'L', 'S', 'Y'};
+// Longer payloads are cut. The last sync marker followed by a valid frame is then always in the recovery window: after
+// it come at most the frames starting in its block, and a torn marker and frame.
+inline constexpr std::uint32_t MAX_PAYLOAD =
+    static_cast<std::uint32_t>((MAX_RECOVERY_WINDOW - BLOCK_SIZE) / 2 - HEADER_SIZE - SYNC_MARKER.size());
+
+namespace details {
+inline constexpr std::array<std::uint32_t, 256> CRC32C_TABLE = [] {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78u : 0);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+inline std::uint32_t crc32c_table(std::uint32_t crc, const unsigned char* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = CRC32C_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if MINILOG_HAS_SSE42_CRC
+[[gnu::target("sse4.2")]] inline std::uint32_t crc32c_sse42(std::uint32_t crc, const unsigned char* data,
+                                                            std::size_t size) {
+#if defined(__x86_64__)
+    std::uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+#endif
+    for (; size > 0; ++data, --size) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+inline void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+inline std::uint32_t get_u32(const unsigned char* data) {
+    return std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8 | std::uint32_t(data[2]) << 16 |
+           std::uint32_t(data[3]) << 24;
+}
+} // namespace details
+
+// CRC32C (Castagnoli) of the data, continuing from a previous result. Uses the SSE4.2 instruction when the CPU has it.
+inline std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc = 0) {
+    auto* bytes = static_cast<const unsigned char*>(data);
+#if MINILOG_HAS_SSE42_CRC
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if (sse42) {
+        return ~details::crc32c_sse42(~crc, bytes, size);
+    }
+#endif
+    return ~details::crc32c_table(~crc, bytes, size);
+}
+
+// Append a frame holding the payload, cut to MAX_PAYLOAD bytes.
+inline void append_frame(std::string& out, std::string_view payload) {
+    payload = payload.substr(0, MAX_PAYLOAD);
+    char length[4];
+    auto size = static_cast<std::uint32_t>(payload.size());
+    for (int i = 0; i < 4; ++i) {
+        length[i] = static_cast<char>(size >> (8 * i));
+    }
+    details::put_u32(out, size);
+    details::put_u32(out, crc32c(payload.data(), payload.size(), crc32c(length, 4)));
+    out += payload;
+}
+
+inline void append_sync_marker(std::string& out) {
+    out.append(reinterpret_cast<const char*>(SYNC_MARKER.data()), SYNC_MARKER.size());
+}
+
+// What was found at an offset of framed data.
+enum class FrameStatus {
+    FRAME,   // A frame with a valid checksum.
+    SYNC,    // A sync marker.
+    END,     // The end of the data.
+    INVALID  // A torn or damaged frame.
+};
+
+// Parse the frame or sync marker at the given offset. On success, `next` is the offset after it and, for a frame,
+// `payload` views its payload in the data.
+inline FrameStatus parse(std::span<const std::byte> data, std::size_t offset, std::string_view& payload,
+                         std::size_t& next) {
+    if (offset == data.size()) {
+        return FrameStatus::END;
+    }
+    auto* bytes = reinterpret_cast<const unsigned char*>(data.data()) + offset;
+    std::size_t available = data.size() - offset;
+    if (available >= SYNC_MARKER.size() && std::memcmp(bytes, SYNC_MARKER.data(), SYNC_MARKER.size()) == 0) {
+        next = offset + SYNC_MARKER.size();
+        return FrameStatus::SYNC;
+    }
+    if (available < HEADER_SIZE) {
+        return FrameStatus::INVALID;
+    }
+    std::uint32_t length = details::get_u32(bytes);
+    if (length > MAX_PAYLOAD || length > available - HEADER_SIZE ||
+        crc32c(bytes + HEADER_SIZE, length, crc32c(bytes, 4)) != details::get_u32(bytes + 4)) {
+        return FrameStatus::INVALID;
+    }
+    payload = {reinterpret_cast<const char*>(bytes + HEADER_SIZE), length};
+    next = offset + HEADER_SIZE + length;
+    return FrameStatus::FRAME;
+}
+
+// Offset of the first sync marker at or after the given offset, or the size of the data if there is none. Used to
+// skip over damage.
+inline std::size_t find_sync_marker(std::span<const std::byte> data, std::size_t offset) {
+    std::string_view text(reinterpret_cast<const char*>(data.data()), data.size());
+    std::string_view marker(reinterpret_cast<const char*>(SYNC_MARKER.data()), SYNC_MARKER.size());
+    std::size_t found = text.find(marker, offset);
+    return found == std::string_view::npos ? data.size() : found;
+}
+
+// End of the valid frames starting at a sync marker or frame boundary: the offset after the last one that parses.
+inline std::size_t valid_end(std::span<const std::byte> data, std::size_t offset) {
+    std::string_view payload;
+    std::size_t next = offset;
+    while (true) {
+        FrameStatus status = parse(data, offset, payload, next);
+        if (status == FrameStatus::END || status == FrameStatus::INVALID) {
+            return offset;
+        }
+        offset = next;
+    }
+}
+
+// Length of the valid prefix of a framed file: everything after it is the remains of an interrupted write. Only the
+// data after the last sync marker that is followed by valid frames is read, doubling the window from one block up to
+// MAX_RECOVERY_WINDOW. Throws if the file does not start with a sync marker, so that a file in another format is not
+// mistaken for a torn write, or if no sync marker is found in the window.
+inline std::uint64_t recover(int fd) {
+    struct stat info{};
+    if (::fstat(fd, &info) != 0) {
+        throw std::runtime_error("Failed to stat framed log file");
+    }
+    auto size = static_cast<std::uint64_t>(info.st_size);
+    if (size == 0) {
+        return 0;
+    }
+    // A file shorter than a marker can only be the beginning of a marker torn by a crash.
+    unsigned char start_marker[SYNC_MARKER.size()];
+    std::size_t prefix = static_cast<std::size_t>(std::min<std::uint64_t>(size, SYNC_MARKER.size()));
+    if (::pread(fd, start_marker, prefix, 0) != static_cast<ssize_t>(prefix)) {
+        throw std::runtime_error("Failed to read framed log file");
+    }
+    if (std::memcmp(start_marker, SYNC_MARKER.data(), prefix) != 0) {
+        throw std::runtime_error("Not a framed log file");
+    }
+    if (size < SYNC_MARKER.size()) {
+        return 0;
+    }
+    std::string window;
+    for (std::uint64_t back = BLOCK_SIZE;; back *= 2) {
+        std::uint64_t start = size > back ? size - back : 0;
+        window.resize(size - start);
+        auto read = ::pread(fd, window.data(), window.size(), static_cast<off_t>(start));
+        if (read != static_cast<ssize_t>(window.size())) {
+            throw std::runtime_error("Failed to read framed log file");
+        }
+        std::span<const std::byte> data(reinterpret_cast<const std::byte*>(window.data()), window.size());
+        std::string_view marker(reinterpret_cast<const char*>(SYNC_MARKER.data()), SYNC_MARKER.size());
+        // A marker counts if a valid frame follows it. This skips a marker torn together with its frame, and bytes in
+        // a payload that happen to look like a marker.
+        for (std::size_t position = window.rfind(marker); position != std::string::npos;
+             position = position == 0 ? std::string::npos : window.rfind(marker, position - 1)) {
+            std::string_view payload;
+            std::size_t next;
+            FrameStatus status = parse(data, position + SYNC_MARKER.size(), payload, next);
+            if (status == FrameStatus::FRAME || status == FrameStatus::END) {
+                return start + valid_end(data, position);
+            }
+        }
+        if (start == 0) {
+            return valid_end(data, 0);
+        }
+        if (back >= MAX_RECOVERY_WINDOW) {
+            throw std::runtime_error("No sync marker at the end of the framed log file");
+        }
+    }
+}
+} // namespace framing
+
+// File sink writing every line as a checksummed frame. When an existing file is opened, a torn frame at its end is
+// cut off before appending. A file that is not framed, e.g. a log written by FileSink, is refused rather than cut.
+// Lines are written with one write(2) each.
+class FramedFileSink {
+public:
+    void open(const std::string& file_name) {
+        fd_ = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open framed log file");
+        }
+        struct stat info{};
+        ::fstat(fd_, &info);
+        try {
+            offset_ = framing::recover(fd_);
+            truncated_ = static_cast<std::uint64_t>(info.st_size) - offset_;
+            if (truncated_ != 0 && ::ftruncate(fd_, static_cast<off_t>(offset_)) != 0) {
+                throw std::runtime_error("Failed to truncate framed log file");
+            }
+        } catch (...) {
+            ::close(fd_);
+            fd_ = -1;
+            throw;
+        }
+        ::lseek(fd_, static_cast<off_t>(offset_), SEEK_SET);
+        marked_block_ = UINT64_MAX; // Mark where appending resumes.
+#if !defined(NDEBUG)
+        std::cout << "Framed log file: " << file_name << ", " << truncated_ << " bytes truncated" << std::endl;
+#endif
+    }
+
+    void write(const LogMessage&, std::string_view line) {
+        frame_.clear();
+        if (offset_ / framing::BLOCK_SIZE != marked_block_) {
+            marked_block_ = offset_ / framing::BLOCK_SIZE;
+            framing::append_sync_marker(frame_);
+        }
+        framing::append_frame(frame_, line);
+        minilog::details::write_all(fd_, frame_);
+        offset_ += frame_.size();
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // Bytes of a torn write cut off the end of the file when it was opened.
+    std::uint64_t truncated_bytes() const {
+        return truncated_;
+    }
+
+private:
+    int fd_ = -1;
+    std::uint64_t offset_ = 0;       // Size of the file.
+    std::uint64_t marked_block_ = 0; // Block of the last sync marker.
+    std::uint64_t truncated_ = 0;
+    std::string frame_;
+};
+
+} // namespace minilog
@@ -0,0 +1,105 @@
+// Merges log files into one timeline: minilog_merge [-o output] file...
+// Every input is memory-mapped and read in order; a heap picks the record with the lowest timestamp, to the nanosecond.
+// Records with the same timestamp are taken in the order of the files on the command line, and then in their order
+// within their file.
+#include <minilog_reader.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+using namespace minilog;
+
+namespace {
+// Next record of an input.
+struct Head {
+    RecordTime time;
+    std::size_t input;
+    std::uint64_t sequence; // Position of the record in its file.
+
+    bool operator>(const Head& other) const {
+        if (time != other.time) {
+            return time > other.time;
+        }
+        if (input != other.input) {
+            return input > other.input;
+        }
+        return sequence > other.sequence;
+    }
+};
+
+struct Input {
+    std::unique_ptr<Reader> reader;
+    Reader::iterator next;
+    std::uint64_t sequence = 0;
+};
+
+int usage() {
+    std::fprintf(stderr, "Usage: minilog_merge [-o output] file...\n");
+    return 2;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* output_name = nullptr;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0) {
+            if (++i == argc) {
+                return usage();
+            }
+            output_name = argv[i];
+        } else {
+            names.emplace_back(argv[i]);
+        }
+    }
+    if (names.empty()) {
+        return usage();
+    }
+
+    std::FILE* output = output_name != nullptr ? std::fopen(output_name, "w") : stdout;
+    if (output == nullptr) {
+        std::fprintf(stderr, "minilog_merge: cannot open %s\n", output_name);
+        return 1;
+    }
+    static char buffer[1 << 20];
+    std::setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+
+    std::vector<Input> inputs(names.size());
+    std::priority_queue<Head, std::vector<Head>, std::greater<>> heap;
+    try {
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            inputs[i].reader = std::make_unique<Reader>(names[i]);
+            inputs[i].next = inputs[i].reader->begin();
+            if (inputs[i].next != inputs[i].reader->end()) {
+                heap.push({inputs[i].next->time, i, 0});
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "minilog_merge: %s\n", e.what());
+        return 1;
+    }
+
+    while (!heap.empty()) {
+        Head head = heap.top();
+        heap.pop();
+        Input& input = inputs[head.input];
+        std::string_view text = input.next->text;
+        std::fwrite(text.data(), 1, text.size(), output);
+        std::fputc('\n', output);
+        if (++input.next != input.reader->end()) {
+            heap.push({input.next->time, head.input, ++input.sequence});
+        }
+    }
+    if (std::fflush(output) != 0) {
+        std::fprintf(stderr, "minilog_merge: write error\n");
+        return 1;
+    }
+    if (output != stdout) {
+        std::fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <minilog_v2.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace minilog {
+
+// Map a log level to an OpenTelemetry severity number.
+inline int to_severity_number(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE: return 1;
+    case LogLevel::DEBUG: return 5;
+    case LogLevel::INFO: return 9;
+    case LogLevel::WARNING: return 13;
+    case LogLevel::ERROR: return 17;
+    case LogLevel::FATAL: return 21;
+    default: return 0;
+    }
+}
+
+// Sink encoding records as OTLP/JSON: every batch is written as one ExportLogsServiceRequest object on its own line,
+// the layout of the OpenTelemetry file exporter. The target is a file, or a Unix domain socket if the path starts
+// with "unix:". Batches are written when they are full, whenever the backend has written a batch of records and, when
+// logging synchronously, after every record. A collector closing the socket does not raise SIGPIPE: the batches are
+// dropped instead.
+class OtlpJsonSink {
+public:
+    // A synchronous logger never ends a batch, and a collector must not wait for records.
+    static constexpr bool flush_each_record = true;
+
+    // Set the target. If no target is set, the file name passed to initialize() is used.
+    void set_path(std::string path) {
+        path_ = std::move(path);
+    }
+
+    // Set the service.name resource attribute.
+    void set_service_name(std::string name) {
+        service_name_ = std::move(name);
+    }
+
+    // Set the number of records per batch.
+    void set_batch_size(std::size_t records) {
+        batch_size_ = records == 0 ? 1 : records;
+    }
+
+    void open(const std::string& file_name) {
+        std::string path = path_.empty() ? file_name : path_;
+        if (path.starts_with("unix:")) {
+            __connect(path.substr(5));
+        } else {
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd_ < 0) {
+                throw std::runtime_error("Failed to open OTLP log file");
+            }
+        }
+#if !defined(NDEBUG)
+        std::cout << "OTLP target: " << path << std::endl;
+#endif
+    }
+
+    void write(const LogMessage& message) {
+        if (count_ != 0) {
+            batch_ += ',';
+        }
+        const CallSite& site = *message.site;
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(message.time.time_since_epoch()).count();
+        std::format_to(std::back_inserter(batch_),
+                       R"({{"timeUnixNano":"{}","observedTimeUnixNano":"{}","severityNumber":{},"severityText":"{}",)",
+                       time, time, to_severity_number(site.level), to_string(site.level));
+        batch_ += R"("body":{"stringValue":")";
+        body_.clear();
+        if (message.literal) {
+            details::append_literal(body_, message.message);
+        } else {
+            body_ += message.message;
+        }
+        __append_escaped(batch_, body_);
+        batch_ += R"("},"attributes":[{"key":"code.filepath","value":{"stringValue":")";
+        __append_escaped(batch_, site.location.file_name());
+        std::format_to(std::back_inserter(batch_), R"("}}}},{{"key":"code.lineno","value":{{"intValue":"{}"}}}})",
+                       site.location.line());
+        batch_ += R"(,{"key":"code.function","value":{"stringValue":")";
+        __append_escaped(batch_, site.location.function_name());
+        batch_ += R"("}}])";
+        if (message.trace != nullptr) {
+            std::format_to(std::back_inserter(batch_), R"(,"traceId":"{:016x}{:016x}","spanId":"{:016x}")",
+                           message.trace->trace_id_high, message.trace->trace_id_low, message.trace->span_id);
+        }
+        batch_ += '}';
+        if (++count_ >= batch_size_) {
+            flush();
+        }
+    }
+
+    // Write the pending batch.
+    void flush() {
+        if (count_ == 0) {
+            return;
+        }
+        out_.clear();
+        out_ += R"({"resourceLogs":[{"resource":{"attributes":[)";
+        if (!service_name_.empty()) {
+            out_ += R"({"key":"service.name","value":{"stringValue":")";
+            __append_escaped(out_, service_name_);
+            out_ += R"("}})";
+        }
+        out_ += R"(]},"scopeLogs":[{"scope":{"name":"minilog"},"logRecords":[)";
+        out_ += batch_;
+        out_ += "]}]}]}\n";
+        __write_all(out_);
+        batch_.clear();
+        count_ = 0;
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            flush();
+            ::close(fd_);
+            fd_ = -1;
+            socket_ = false;
+        }
+    }
+
+private:
+#if defined(MSG_NOSIGNAL)
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0; // SO_NOSIGPIPE is set on the socket instead.
+#endif
+
+    void __connect(const std::string& socket_path) {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("OTLP socket path is too long");
+        }
+        address.sun_family = AF_UNIX;
+        socket_path.copy(address.sun_path, socket_path.size());
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0 || ::connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+            throw std::runtime_error("Failed to connect to OTLP socket");
+        }
+#if defined(SO_NOSIGPIPE)
+        int on = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        socket_ = true;
+    }
+
+    void __write_all(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t written = socket_ ? ::send(fd_, data.data(), data.size(), SEND_FLAGS)
+                                      : ::write(fd_, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return; // The collector is gone; drop the batch rather than stall the backend.
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+    }
+
+    // Append a string as the contents of a JSON string.
+    static void __append_escaped(std::string& out, std::string_view text) {
+        for (char c : text) {
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(c));
+                } else {
+                    out += c;
+                }
+            }
+        }
+    }
+
+    int fd_ = -1;
+    bool socket_ = false;
+    std::string path_;
+    std::string service_name_;
+    std::size_t batch_size_ = 512;
+    std::size_t count_ = 0; // Records in the pending batch.
+    std::string batch_;     // Encoded records of the pending batch.
+    std::string body_;      // Message of the record being encoded.
+    std::string out_;       // Encoded request.
+};
+
+} // namespace minilog
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <minilog_framing.hpp>
+
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minilog {
+
+// Read-only memory mapping of a file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file_name) {
+        int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + file_name);
+        }
+        struct stat info{};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat " + file_name);
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ != 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Failed to map " + file_name);
+            }
+            ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (size_ != 0) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    std::string_view view() const {
+        return {static_cast<const char*>(data_), size_};
+    }
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Local time of a record, as written, with the fractional seconds if the file has them.
+using RecordTime = std::chrono::local_time<std::chrono::nanoseconds>;
+
+// A record of a log file, viewing the mapped file. Timestamps are local times, as written.
+struct RecordView {
+    RecordTime time;
+    LogLevel level;
+    std::string_view file;
+    std::uint32_t line;
+    std::string_view trace;   // "trace_id:span_id", or empty.
+    std::string_view message; // The message, followed by the backtrace lines if there are any.
+    std::string_view text;    // The whole record, without the final newline.
+};
+
+// Reader of the files written by FileSink or FramedFileSink. The file is mapped, and records are parsed in place
+// without copying. Records are assumed to be in time order, which holds for the output of one logger up to the
+// slight reordering between threads of an asynchronous logger.
+class Reader {
+public:
+    // Iterator over the records of a file, up to the end or to a time limit.
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        const RecordView& operator*() const {
+            return record_;
+        }
+
+        const RecordView* operator->() const {
+            return &record_;
+        }
+
+        iterator& operator++() {
+            __advance();
+            return *this;
+        }
+
+        void operator++(int) {
+            __advance();
+        }
+
+        bool operator==(const iterator& other) const {
+            return reader_ == other.reader_ && next_ == other.next_;
+        }
+
+    private:
+        friend class Reader;
+
+        iterator(const Reader* reader, std::size_t offset, std::optional<RecordTime> until)
+            : reader_(reader), next_(offset), until_(until) {
+            __advance();
+        }
+
+        void __advance() {
+            if (reader_ == nullptr || !reader_->__next(next_, record_) || (until_ && record_.time >= *until_)) {
+                reader_ = nullptr;
+                next_ = 0;
+            }
+        }
+
+        const Reader* reader_ = nullptr; // nullptr at the end.
+        std::size_t next_ = 0;           // Offset of the next record.
+        std::optional<RecordTime> until_;
+        RecordView record_{};
+    };
+
+    // Records between two times, as returned by range().
+    struct Range {
+        iterator first;
+
+        iterator begin() const {
+            return first;
+        }
+
+        iterator end() const {
+            return {};
+        }
+    };
+
+    explicit Reader(const std::string& file_name) : file_(file_name), data_(file_.view()) {
+        framed_ = data_.starts_with(
+            std::string_view(reinterpret_cast<const char*>(framing::SYNC_MARKER.data()), framing::SYNC_MARKER.size()));
+    }
+
+    // Whether the file was written by FramedFileSink.
+    bool framed() const {
+        return framed_;
+    }
+
+    iterator begin() const {
+        return {this, 0, std::nullopt};
+    }
+
+    iterator end() const {
+        return {};
+    }
+
+    // Records with a time in [from, until). The first one is found with a binary search over the file.
+    Range range(RecordTime from, RecordTime until) const {
+        std::size_t low = 0;
+        std::size_t high = data_.size();
+        RecordView record;
+        while (low < high) {
+            std::size_t middle = low + (high - low) / 2;
+            std::size_t offset = __boundary(middle);
+            if (!__next(offset, record) || record.time >= from) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        std::size_t start = __boundary(low);
+        if (framed_ && start != 0) {
+            // Records between the previous sync marker and this one can also be in the range.
+            start = __previous_marker(start);
+        }
+        iterator first(this, start, until);
+        while (first != iterator() && first->time < from) {
+            ++first;
+        }
+        return {first};
+    }
+
+private:
+    // Parse the record at `offset` and move it past the record. Damaged frames are skipped. Returns false at the end.
+    bool __next(std::size_t& offset, RecordView& record) const {
+        while (offset < data_.size()) {
+            std::string_view text;
+            if (framed_) {
+                std::span<const std::byte> bytes(reinterpret_cast<const std::byte*>(data_.data()), data_.size());
+                std::size_t next = offset;
+                framing::FrameStatus status = framing::parse(bytes, offset, text, next);
+                if (status == framing::FrameStatus::END) {
+                    return false;
+                }
+                if (status == framing::FrameStatus::INVALID) {
+                    offset = framing::find_sync_marker(bytes, offset + 1);
+                    continue;
+                }
+                offset = next;
+                if (status == framing::FrameStatus::SYNC) {
+                    continue;
+                }
+            } else {
+                std::size_t end = __text_record_end(offset);
+                text = data_.substr(offset, end - offset);
+                offset = end;
+            }
+            if (text.ends_with('\n')) {
+                text.remove_suffix(1);
+            }
+            if (__parse(text, record)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // End of the text record starting at `offset`: after the last line before the next line that starts a record.
+    std::size_t __text_record_end(std::size_t offset) const {
+        while (true) {
+            std::size_t newline = data_.find('\n', offset);
+            if (newline == std::string_view::npos) {
+                return data_.size();
+            }
+            offset = newline + 1;
+            if (offset == data_.size() || __starts_record(data_.substr(offset))) {
+                return offset;
+            }
+        }
+    }
+
+    // Offset of the first record boundary at or after `offset`.
+    std::size_t __boundary(std::size_t offset) const {
+        if (offset == 0 || offset >= data_.size()) {
+            return std::min(offset, data_.size());
+        }
+        if (framed_) {
+            std::span<const std::byte> bytes(reinterpret_cast<const std::byte*>(data_.data()), data_.size());
+            return framing::find_sync_marker(bytes, offset);
+        }
+        for (std::size_t newline = data_.find('\n', offset - 1); newline != std::string_view::npos;
+             newline = data_.find('\n', newline + 1)) {
+            if (newline + 1 == data_.size() || __starts_record(data_.substr(newline + 1))) {
+                return newline + 1;
+            }
+        }
+        return data_.size();
+    }
+
+    std::size_t __previous_marker(std::size_t offset) const {
+        auto* marker_data = reinterpret_cast<const char*>(framing::SYNC_MARKER.data());
+        std::size_t found = data_.rfind(std::string_view(marker_data, framing::SYNC_MARKER.size()), offset - 1);
+        return found == std::string_view::npos ? 0 : found;
+    }
+
+    // Whether the text starts with a "YYYY/MM/DD hh:mm:ss[.f...] " timestamp.
+    static bool __starts_record(std::string_view text) {
+        return __timestamp_size(text) != 0;
+    }
+
+    // Size of the timestamp at the start of the text, with its fractional seconds and the space after it, or 0 if
+    // there is none.
+    static std::size_t __timestamp_size(std::string_view text) {
+        static constexpr std::string_view pattern = "0000/00/00 00:00:00";
+        if (text.size() < pattern.size()) {
+            return 0;
+        }
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] == '0' ? !__digit(text[i]) : text[i] != pattern[i]) {
+                return 0;
+            }
+        }
+        std::size_t size = pattern.size();
+        if (size < text.size() && text[size] == '.') {
+            std::size_t digits = ++size;
+            while (size < text.size() && __digit(text[size])) {
+                ++size;
+            }
+            if (size == digits) {
+                return 0;
+            }
+        }
+        return size < text.size() && text[size] == ' ' ? size + 1 : 0;
+    }
+
+    static bool __digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static int __number(std::string_view text, std::size_t position, std::size_t digits) {
+        int value = 0;
+        for (std::size_t i = position; i < position + digits; ++i) {
+            value = value * 10 + (text[i] - '0');
+        }
+        return value;
+    }
+
+    // Parse "YYYY/MM/DD hh:mm:ss[.f...] [LEVEL] [file:line] [trace:span] message". Digits of the fractional seconds
+    // past nanoseconds are ignored.
+    static bool __parse(std::string_view text, RecordView& record) {
+        std::size_t timestamp_size = __timestamp_size(text);
+        if (timestamp_size == 0) {
+            return false;
+        }
+        record.text = text;
+        auto date = std::chrono::year(__number(text, 0, 4)) / std::chrono::month(__number(text, 5, 2)) /
+                    std::chrono::day(__number(text, 8, 2));
+        record.time = std::chrono::local_days(date) + std::chrono::hours(__number(text, 11, 2)) +
+                      std::chrono::minutes(__number(text, 14, 2)) + std::chrono::seconds(__number(text, 17, 2));
+        if (timestamp_size > 20) {
+            std::string_view fraction = text.substr(20, timestamp_size - 21);
+            std::int64_t nanoseconds = 0;
+            for (std::size_t i = 0; i < 9; ++i) {
+                nanoseconds = nanoseconds * 10 + (i < fraction.size() ? fraction[i] - '0' : 0);
+            }
+            record.time += std::chrono::nanoseconds(nanoseconds);
+        }
+        text.remove_prefix(timestamp_size);
+        std::string_view level = __field(text);
+        std::string_view location = __field(text);
+        std::size_t colon = location.rfind(':');
+        if (level.empty() || colon == std::string_view::npos) {
+            return false;
+        }
+        record.level = LogLevel::FATAL;
+        for (int i = static_cast<int>(LogLevel::TRACE); i <= static_cast<int>(LogLevel::FATAL); ++i) {
+            if (to_string(static_cast<LogLevel>(i)) == level) {
+                record.level = static_cast<LogLevel>(i);
+            }
+        }
+        record.file = location.substr(0, colon);
+        std::string_view line = location.substr(colon + 1);
+        if (std::from_chars(line.data(), line.data() + line.size(), record.line).ec != std::errc()) {
+            return false;
+        }
+        // A trace context is 32 + 1 + 16 hex digits in brackets.
+        record.trace = {};
+        if (text.size() >= 52 && text[0] == '[' && text[33] == ':' && text[50] == ']' && text[51] == ' ') {
+            record.trace = text.substr(1, 49);
+            text.remove_prefix(52);
+        }
+        record.message = text;
+        return true;
+    }
+
+    // Take a "[value] " field off the front of the text.
+    static std::string_view __field(std::string_view& text) {
+        std::size_t close = text.find("] ");
+        if (!text.starts_with('[') || close == std::string_view::npos) {
+            return {};
+        }
+        std::string_view value = text.substr(1, close - 1);
+        text.remove_prefix(close + 2);
+        return value;
+    }
+
+    MappedFile file_;
+    std::string_view data_;
+    bool framed_ = false;
+};
+
+} // namespace minilog
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <minilog_framing.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace minilog {
+
+// Segmented log store, laid out like a Kafka partition. Records are numbered from 0 and written as frames (see
+// minilog_framing.hpp) to segment files named after the sequence number of their first record,
+// <base>.<20 digits>.log. Each segment has an index, <base>.<20 digits>.index, with an entry every INDEX_INTERVAL
+// bytes of records: sequence number, timestamp and byte offset, as little-endian 64-bit integers. Looking up a
+// sequence number or a time is a binary search over the index and a short scan of the segment.
+namespace segments {
+inline constexpr std::size_t INDEX_ENTRY_SIZE = 24;
+
+// Entry of a segment index.
+struct IndexEntry {
+    std::uint64_t sequence;
+    std::int64_t time; // Nanoseconds since the epoch.
+    std::uint64_t offset;
+};
+
+// Files of a segment.
+struct Segment {
+    std::uint64_t first_sequence;
+    std::filesystem::path log;
+    std::filesystem::path index;
+};
+
+namespace details {
+inline void put_u64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+inline std::uint64_t get_u64(const unsigned char* data) {
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
+
+inline std::filesystem::path segment_path(const std::filesystem::path& base, std::uint64_t first, const char* suffix) {
+    return base.string() + std::format(".{:020}{}", first, suffix);
+}
+} // namespace details
+
+// Encode an index entry.
+inline void append_index_entry(std::string& out, const IndexEntry& entry) {
+    details::put_u64(out, entry.sequence);
+    details::put_u64(out, static_cast<std::uint64_t>(entry.time));
+    details::put_u64(out, entry.offset);
+}
+
+// Decode the entries of an index. A torn entry at the end is ignored.
+inline std::vector<IndexEntry> parse_index(std::string_view data) {
+    std::vector<IndexEntry> entries;
+    entries.reserve(data.size() / INDEX_ENTRY_SIZE);
+    auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    for (std::size_t offset = 0; offset + INDEX_ENTRY_SIZE <= data.size(); offset += INDEX_ENTRY_SIZE) {
+        const unsigned char* entry = bytes + offset;
+        entries.push_back({details::get_u64(entry), static_cast<std::int64_t>(details::get_u64(entry + 8)),
+                           details::get_u64(entry + 16)});
+    }
+    return entries;
+}
+
+// Segments of a store, by first sequence number.
+inline std::vector<Segment> list(const std::filesystem::path& base) {
+    std::vector<Segment> found;
+    std::filesystem::path directory = base.has_parent_path() ? base.parent_path() : std::filesystem::path(".");
+    std::string prefix = base.filename().string() + '.';
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() != prefix.size() + 20 + 4 || !name.starts_with(prefix) || !name.ends_with(".log")) {
+            continue;
+        }
+        std::uint64_t first = 0;
+        const char* digits = name.data() + prefix.size();
+        if (std::from_chars(digits, digits + 20, first).ptr != digits + 20) {
+            continue;
+        }
+        found.push_back(
+            {first, details::segment_path(base, first, ".log"), details::segment_path(base, first, ".index")});
+    }
+    std::sort(found.begin(), found.end(),
+              [](const Segment& a, const Segment& b) { return a.first_sequence < b.first_sequence; });
+    return found;
+}
+
+// Index of the segment holding a sequence number: the last one starting at or before it.
+inline std::optional<std::size_t> find_segment(const std::vector<Segment>& segments, std::uint64_t sequence) {
+    auto it = std::upper_bound(
+        segments.begin(), segments.end(), sequence,
+        [](std::uint64_t value, const Segment& segment) { return value < segment.first_sequence; });
+    if (it == segments.begin()) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(it - segments.begin() - 1);
+}
+
+// The index entry to start scanning from for a sequence number: the last one at or before it.
+inline IndexEntry seek_sequence(const std::vector<IndexEntry>& index, std::uint64_t sequence, std::uint64_t first) {
+    auto it = std::upper_bound(index.begin(), index.end(), sequence,
+                               [](std::uint64_t value, const IndexEntry& entry) { return value < entry.sequence; });
+    return it == index.begin() ? IndexEntry{first, 0, 0} : *(it - 1);
+}
+
+// The index entry to start scanning from for a time: the last one before it. Timestamps of records from different
+// threads can be slightly out of order, so the scan should start one entry earlier when exact results are needed.
+inline IndexEntry seek_time(const std::vector<IndexEntry>& index, std::int64_t time, std::uint64_t first) {
+    auto it = std::lower_bound(index.begin(), index.end(), time,
+                               [](const IndexEntry& entry, std::int64_t value) { return entry.time < value; });
+    return it == index.begin() ? IndexEntry{first, 0, 0} : *(it - 1);
+}
+} // namespace segments
+
+// File sink writing framed lines to a segmented store (see namespace segments). The file name passed to initialize()
+// is the base name of the segments. A new segment is started when the current one reaches the segment size. When the
+// store exists, the torn tail of the last segment is cut off and numbering continues after its last record.
+class SegmentedFileSink {
+public:
+    // Set the size at which a new segment is started.
+    void set_segment_size(std::uint64_t bytes) {
+        segment_size_ = bytes;
+    }
+
+    // Set the number of bytes of records between two index entries.
+    void set_index_interval(std::uint64_t bytes) {
+        index_interval_ = bytes;
+    }
+
+    // Sequence number of the next record.
+    std::uint64_t next_sequence() const {
+        return sequence_;
+    }
+
+    void open(const std::string& file_name) {
+        base_ = file_name;
+        std::vector<segments::Segment> existing = segments::list(base_);
+        try {
+            if (existing.empty()) {
+                __open_segment(0);
+            } else {
+                __resume(existing.back());
+            }
+        } catch (...) {
+            __close_segment();
+            throw;
+        }
+#if !defined(NDEBUG)
+        std::cout << "Segmented log: " << file_name << ", next sequence number " << sequence_ << std::endl;
+#endif
+    }
+
+    void write(const LogMessage& message, std::string_view line) {
+        frame_.clear();
+        if (offset_ / framing::BLOCK_SIZE != marked_block_) {
+            marked_block_ = offset_ / framing::BLOCK_SIZE;
+            framing::append_sync_marker(frame_);
+        }
+        framing::append_frame(frame_, line);
+        if (offset_ != 0 && offset_ + frame_.size() > segment_size_) {
+            __close_segment();
+            __open_segment(sequence_);
+            frame_.clear();
+            marked_block_ = 0;
+            framing::append_sync_marker(frame_);
+            framing::append_frame(frame_, line);
+        }
+        if (offset_ == 0 || offset_ - indexed_offset_ >= index_interval_) {
+            index_entry_.clear();
+            auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(message.time.time_since_epoch()).count();
+            segments::append_index_entry(index_entry_, {sequence_, time, offset_});
+            minilog::details::write_all(index_fd_, index_entry_);
+            indexed_offset_ = offset_;
+        }
+        minilog::details::write_all(log_fd_, frame_);
+        offset_ += frame_.size();
+        ++sequence_;
+    }
+
+    void close() {
+        __close_segment();
+    }
+
+private:
+    void __open_segment(std::uint64_t first) {
+        log_fd_ = __open_file(segments::details::segment_path(base_, first, ".log"));
+        index_fd_ = __open_file(segments::details::segment_path(base_, first, ".index"));
+        offset_ = 0;
+        indexed_offset_ = 0;
+        marked_block_ = UINT64_MAX;
+    }
+
+    // Reopen the last segment: cut off a torn frame, drop index entries past the end and count the records after the
+    // last index entry, so that only the tail of the segment is read.
+    void __resume(const segments::Segment& segment) {
+        log_fd_ = __open_file(segment.log);
+        index_fd_ = __open_file(segment.index);
+        std::uint64_t end = framing::recover(log_fd_);
+        __truncate(log_fd_, end);
+        offset_ = end;
+        marked_block_ = UINT64_MAX;
+
+        struct stat info{};
+        ::fstat(index_fd_, &info);
+        std::string index(static_cast<std::size_t>(info.st_size), '\0');
+        if (::pread(index_fd_, index.data(), index.size(), 0) != static_cast<ssize_t>(index.size())) {
+            throw std::runtime_error("Failed to read log segment index");
+        }
+        std::vector<segments::IndexEntry> entries = segments::parse_index(index);
+        while (!entries.empty() && entries.back().offset >= end) {
+            entries.pop_back();
+        }
+        __truncate(index_fd_, entries.size() * segments::INDEX_ENTRY_SIZE);
+        indexed_offset_ = entries.empty() ? 0 : entries.back().offset;
+        if (entries.empty() && end != 0) {
+            // Keep the invariant that the first record of a segment is indexed.
+            index_entry_.clear();
+            segments::append_index_entry(index_entry_, {segment.first_sequence, 0, 0});
+            minilog::details::write_all(index_fd_, index_entry_);
+        }
+
+        std::optional<std::uint64_t> records;
+        if (!entries.empty()) {
+            records = __count_records(entries.back().offset, end, false);
+            sequence_ = entries.back().sequence;
+        }
+        if (!records) {
+            // No index entry, or one that does not point at a frame boundary: count from the start.
+            records = __count_records(0, end, true);
+            sequence_ = segment.first_sequence;
+        }
+        sequence_ += *records;
+    }
+
+    // Number of records of the current segment between `from` and `end`. Damaged frames are skipped up to the next
+    // sync marker if `skip_damage` is set; otherwise nothing is returned.
+    std::optional<std::uint64_t> __count_records(std::uint64_t from, std::uint64_t end, bool skip_damage) const {
+        std::string data(static_cast<std::size_t>(end - from), '\0');
+        if (::pread(log_fd_, data.data(), data.size(), static_cast<off_t>(from)) != static_cast<ssize_t>(data.size())) {
+            throw std::runtime_error("Failed to read log segment");
+        }
+        std::span<const std::byte> bytes(reinterpret_cast<const std::byte*>(data.data()), data.size());
+        std::uint64_t records = 0;
+        std::string_view payload;
+        for (std::size_t offset = 0, next = 0;; offset = next) {
+            framing::FrameStatus status = framing::parse(bytes, offset, payload, next);
+            if (status == framing::FrameStatus::FRAME) {
+                ++records;
+            } else if (status == framing::FrameStatus::END) {
+                return records;
+            } else if (status == framing::FrameStatus::INVALID) {
+                if (!skip_damage) {
+                    return std::nullopt;
+                }
+                next = framing::find_sync_marker(bytes, offset + 1);
+            }
+        }
+    }
+
+    void __close_segment() {
+        for (int* fd : {&log_fd_, &index_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    static int __open_file(const std::filesystem::path& path) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open log segment " + path.string());
+        }
+        return fd;
+    }
+
+    static void __truncate(int fd, std::uint64_t size) {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Failed to truncate log segment");
+        }
+    }
+
+    std::string base_;
+    std::uint64_t segment_size_ = 64 * 1024 * 1024;
+    std::uint64_t index_interval_ = 4096;
+    int log_fd_ = -1;
+    int index_fd_ = -1;
+    std::uint64_t sequence_ = 0;       // Sequence number of the next record.
+    std::uint64_t offset_ = 0;         // Size of the current segment.
+    std::uint64_t indexed_offset_ = 0; // Offset of the last index entry.
+    std::uint64_t marked_block_ = 0;   // Block of the last sync marker.
+    std::string frame_;
+    std::string index_entry_;
+};
+
+} // namespace minilog
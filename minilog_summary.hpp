@@ -0,0 +1,309 @@
+#pragma once
+
+#include <minilog_v2.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace minilog {
+
+// How SummarySink groups records.
+enum class Grouping {
+    CALL_SITE, // By log statement: the template is the format string.
+    TEMPLATE   // By template mined from the messages, so that messages logged through a dynamic string are grouped.
+};
+
+// Template mining with the Drain algorithm (He et al., "Drain: An Online Log Parsing Approach with Fixed Depth Tree",
+// ICWS 2017). Messages are split into words. A message is only compared to the templates with the same number of words
+// and the same first words, words with digits counting as variables. It joins the most similar of them if at least
+// the similarity threshold of its words are equal, and the words that differ become variables, written "<*>".
+// Otherwise it starts a new template, unless there are already as many as the maximum.
+class TemplateMiner {
+public:
+    static constexpr std::string_view VARIABLE = "<*>";
+
+    // Index returned for a message that matches no template when no new one can be started.
+    static constexpr std::size_t OTHER = SIZE_MAX;
+
+    // Set the fraction of equal words needed to join a template. Default is 0.5.
+    void set_similarity(double similarity) {
+        similarity_ = similarity;
+    }
+
+    // Set the number of first words that select the templates a message is compared to. Default is 2.
+    void set_depth(std::size_t depth) {
+        depth_ = depth;
+    }
+
+    // Set the maximum number of templates. Default is 1000.
+    void set_max_templates(std::size_t max_templates) {
+        max_templates_ = max_templates;
+    }
+
+    // Number of templates.
+    std::size_t size() const {
+        return templates_.size() - free_.size();
+    }
+
+    // Find or create the template of a message. Returns its index, or OTHER if the message matches no template and
+    // there are already as many as the maximum.
+    std::size_t add(std::string_view message) {
+        words_.clear();
+        for (std::size_t start = message.find_first_not_of(' '); start != std::string_view::npos;) {
+            std::size_t end = std::min(message.find(' ', start), message.size());
+            words_.push_back(message.substr(start, end - start));
+            start = message.find_first_not_of(' ', end);
+        }
+        key_ = std::to_string(words_.size());
+        for (std::size_t i = 0; i < std::min(depth_, words_.size()); ++i) {
+            key_ += ' ';
+            key_ += __has_digit(words_[i]) ? VARIABLE : words_[i];
+        }
+        std::vector<std::size_t>& group = groups_[key_];
+        std::size_t best = SIZE_MAX;
+        double best_similarity = -1;
+        std::size_t best_variables = 0;
+        for (std::size_t index : group) {
+            auto [similarity, variables] = __similarity(templates_[index].words, words_);
+            if (similarity > best_similarity || (similarity == best_similarity && variables > best_variables)) {
+                best = index;
+                best_similarity = similarity;
+                best_variables = variables;
+            }
+        }
+        if (best != SIZE_MAX && best_similarity >= similarity_) {
+            std::vector<std::string>& words = templates_[best].words;
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                if (words[i] != words_[i]) {
+                    words[i] = VARIABLE;
+                }
+            }
+            return best;
+        }
+        if (size() >= max_templates_) {
+            if (group.empty()) {
+                groups_.erase(key_);
+            }
+            return OTHER;
+        }
+        // Reuse the index of a removed template, so that the indexes stay below the maximum.
+        std::size_t index = templates_.size();
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            templates_.emplace_back();
+        }
+        templates_[index] = {{words_.begin(), words_.end()}, key_};
+        group.push_back(index);
+        return index;
+    }
+
+    // Remove a template. Its index is given to a later one.
+    void remove(std::size_t index) {
+        Template& removed = templates_[index];
+        auto group = groups_.find(removed.key);
+        std::erase(group->second, index);
+        if (group->second.empty()) {
+            groups_.erase(group);
+        }
+        removed = {};
+        free_.push_back(index);
+    }
+
+    // Get a template as text.
+    std::string text(std::size_t index) const {
+        std::string text;
+        for (const std::string& word : templates_[index].words) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            text += word;
+        }
+        return text;
+    }
+
+private:
+    static bool __has_digit(std::string_view word) {
+        return word.find_first_of("0123456789") != std::string_view::npos;
+    }
+
+    // Fraction of the words of a message equal to those of a template, and the number of variables of the template.
+    static std::pair<double, std::size_t> __similarity(const std::vector<std::string>& words,
+                                                       const std::vector<std::string_view>& message) {
+        std::size_t equal = 0;
+        std::size_t variables = 0;
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            if (words[i] == VARIABLE) {
+                ++variables;
+            } else if (words[i] == message[i]) {
+                ++equal;
+            }
+        }
+        return {words.empty() ? 1.0 : static_cast<double>(equal) / words.size(), variables};
+    }
+
+    struct Template {
+        std::vector<std::string> words;
+        std::string key; // Key of its group.
+    };
+
+    double similarity_ = 0.5;
+    std::size_t depth_ = 2;
+    std::size_t max_templates_ = 1000;
+    std::vector<Template> templates_;
+    std::vector<std::size_t> free_; // Indexes of removed templates.
+    std::unordered_map<std::string, std::vector<std::size_t>> groups_; // Templates by word count and first words.
+    std::vector<std::string_view> words_;
+    std::string key_;
+};
+
+// Sink writing a summary of the records to a file instead of every line: once per interval, one line per template
+// that occurred, with its count and a uniform sample of its messages (reservoir sampling), e.g.
+//   2024/05/01 12:00:00 [INFO] [server.cpp:42] 1200000 x "Request <*> served in <*> ms" (35000000 in total)
+//       Request 8812 served in 3 ms
+//       ...
+// The summary is written with the first record after the end of an interval, and when the sink is closed. When grouping
+// by template, a template without records for a whole interval is forgotten, and the messages that match no template
+// once the miner has its maximum number of templates are counted together under the template "<*>".
+class SummarySink {
+public:
+    // Set how records are grouped. Default is by call site.
+    void set_grouping(Grouping grouping) {
+        grouping_ = grouping;
+    }
+
+    // Set the time between summaries. Default is one minute.
+    void set_interval(std::chrono::system_clock::duration interval) {
+        interval_ = interval;
+    }
+
+    // Set the number of example messages per template. Default is 5.
+    void set_examples(std::size_t examples) {
+        examples_ = examples;
+    }
+
+    // The template miner used when grouping by template.
+    TemplateMiner& miner() {
+        return miner_;
+    }
+
+    void open(const std::string& file_name) {
+        file_.open(file_name, std::ios::app);
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open summary file");
+        }
+#if !defined(NDEBUG)
+        std::cout << "Summary file: " << file_name << std::endl;
+#endif
+    }
+
+    void write(const LogMessage& message) {
+        if (interval_start_ == std::chrono::system_clock::time_point()) {
+            interval_start_ = message.time;
+        } else if (message.time - interval_start_ >= interval_) {
+            __write_summary(message.time);
+        }
+        text_.clear();
+        if (message.literal) {
+            details::append_literal(text_, message.message);
+        } else {
+            text_ += message.message;
+        }
+        std::size_t index = grouping_ == Grouping::CALL_SITE ? message.site->id : miner_.add(text_);
+        if (index != TemplateMiner::OTHER && index >= groups_.size()) {
+            groups_.resize(index + 1);
+        }
+        Group& group = index == TemplateMiner::OTHER ? other_ : groups_[index];
+        if (group.site == nullptr || message.site->level > group.site->level) {
+            group.site = message.site;
+        }
+        ++group.total;
+        // Algorithm R: the n-th message replaces a random example with probability examples / n.
+        if (++group.count <= examples_) {
+            group.examples.push_back(text_);
+        } else if (std::uint64_t slot = random_() % group.count; slot < examples_) {
+            group.examples[slot] = text_;
+        }
+    }
+
+    // Close the sink at the given time of the logger clock, writing the summary of the last interval.
+    void close(std::chrono::system_clock::time_point now) {
+        if (file_.is_open()) {
+            __write_summary(now);
+            file_.close();
+        }
+    }
+
+private:
+    // Counters of a template in the current interval.
+    struct Group {
+        const CallSite* site = nullptr; // The call site with the highest level that logged the template.
+        std::uint64_t count = 0;
+        std::uint64_t total = 0;
+        std::vector<std::string> examples;
+    };
+
+    void __write_summary(std::chrono::system_clock::time_point now) {
+        timestamp_.clear();
+        std::format_to(std::back_inserter(timestamp_), "{:%Y/%m/%d %H:%M:%S} ",
+                       std::chrono::zoned_time(std::chrono::current_zone(), now));
+        line_.clear();
+        for (std::size_t index = 0; index < groups_.size(); ++index) {
+            Group& group = groups_[index];
+            if (group.count != 0) {
+                __write_group(group,
+                              grouping_ == Grouping::CALL_SITE ? std::string(group.site->format) : miner_.text(index));
+            } else if (grouping_ == Grouping::TEMPLATE && group.site != nullptr) {
+                // Idle for the whole interval: free its place for a new template.
+                miner_.remove(index);
+                group = Group();
+            }
+        }
+        if (other_.count != 0) {
+            __write_group(other_, std::string(TemplateMiner::VARIABLE));
+        }
+        file_ << line_;
+        file_.flush();
+        interval_start_ = now;
+    }
+
+    void __write_group(Group& group, const std::string& text) {
+        line_ += timestamp_;
+        const CallSite& site = *group.site;
+        std::format_to(std::back_inserter(line_), "[{}] [{}:{}] {} x \"{}\" ({} in total)\n", to_string(site.level),
+                       site.location.file_name(), site.location.line(), group.count, text, group.total);
+        for (const std::string& example : group.examples) {
+            line_ += "    ";
+            line_ += example;
+            line_ += '\n';
+        }
+        group.count = 0;
+        group.examples.clear();
+    }
+
+    Grouping grouping_ = Grouping::CALL_SITE;
+    std::chrono::system_clock::duration interval_ = std::chrono::minutes(1);
+    std::size_t examples_ = 5;
+    std::chrono::system_clock::time_point interval_start_;
+    TemplateMiner miner_;
+    std::vector<Group> groups_; // By call site id or template index.
+    Group other_;               // Messages that match no template.
+    std::minstd_rand random_;
+    std::ofstream file_;
+    std::string text_;
+    std::string line_;
+    std::string timestamp_;
+};
+
+} // namespace minilog
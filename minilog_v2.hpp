@@ -1,134 +1,1715 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
-#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <source_location>
+#include <span>
 #include <stop_token>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// USDT probes. With MINILOG_ENABLE_USDT and <sys/sdt.h> (systemtap-sdt-dev), every log statement and the backend
+// stages get a static probe point that compiles to a nop until a tracer such as bpftrace attaches to it:
+//   log(level, call_site, format, enabled)   at every LOG_* statement, also for messages that are dropped
+//   enqueue(level, call_site, text, size)    when a record is committed to the ring buffer
+//   dequeue(level, call_site, text, size)    when the backend takes a record out of the ring buffer
+//   write(level, call_site, line, size)      when a message has been passed to the sinks
+//   flush(records)                           when the backend flushes the sinks after a batch
+// The call site argument is the address of the static CallSite, which identifies the statement. The text of a record
+// is its formatted message, or the format string if the record holds a constant message or raw arguments.
+#if defined(MINILOG_ENABLE_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MINILOG_PROBE(name, ...) STAP_PROBEV(minilog, name __VA_OPT__(, ) __VA_ARGS__)
+#define MINILOG_HAS_USDT 1
+#else
+#define MINILOG_PROBE(name, ...) ((void)0)
+#define MINILOG_HAS_USDT 0
+#endif
+
+// Backtraces are captured with the unwinder of the C++ runtime and symbolized with dladdr.
+#if __has_include(<unwind.h>) && __has_include(<dlfcn.h>) && __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unwind.h>
+#define MINILOG_HAS_BACKTRACE 1
+#else
+#define MINILOG_HAS_BACKTRACE 0
+#endif
+
+// Thread ids for the names of per-thread files.
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Cycle counter read by real-time log statements.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Signal-safe logging formats on the stack and writes the line to the log file with write(2).
+#if __has_include(<unistd.h>) && __has_include(<fcntl.h>)
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#define MINILOG_HAS_SIGNAL_SAFE 1
+#else
+#define MINILOG_HAS_SIGNAL_SAFE 0
+#endif
 
 namespace minilog {
 
-// Log level.
-enum class LogLevel {
-    TRACE,
-    DEBUG,
-    INFO,
-    WARNING,
-    ERROR,
-    FATAL
+// Log level.
+enum class LogLevel {
+    TRACE,
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR,
+    FATAL
+};
+
+// Get the name of a log level.
+inline std::string_view to_string(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE: return "TRACE";
+    case LogLevel::DEBUG: return "DEBUG";
+    case LogLevel::INFO: return "INFO";
+    case LogLevel::WARNING: return "WARNING";
+    case LogLevel::ERROR: return "ERROR";
+    case LogLevel::FATAL: return "FATAL";
+    default: return "UNKNOWN";
+    }
+}
+
+namespace details {
+// Log level threshold override of the current thread. Above every level when there is no override.
+inline thread_local LogLevel level_override = static_cast<LogLevel>(static_cast<int>(LogLevel::FATAL) + 1);
+} // namespace details
+
+// Raise the verbosity of the current thread for the lifetime of the guard, e.g. while handling one flagged request.
+// A coroutine that resumes on another thread must establish its own override there.
+class scoped_level_override {
+public:
+    explicit scoped_level_override(LogLevel level) : previous_(details::level_override) {
+        details::level_override = level;
+    }
+
+    ~scoped_level_override() {
+        details::level_override = previous_;
+    }
+
+    scoped_level_override(const scoped_level_override&) = delete;
+    scoped_level_override& operator=(const scoped_level_override&) = delete;
+
+private:
+    LogLevel previous_;
+};
+
+// Trace context carried into log records. The ids follow W3C Trace Context: a 16-byte trace id and an 8-byte span id.
+struct TraceContext {
+    std::uint64_t trace_id_high = 0;
+    std::uint64_t trace_id_low = 0;
+    std::uint64_t span_id = 0;
+
+    bool empty() const {
+        return trace_id_high == 0 && trace_id_low == 0;
+    }
+};
+
+namespace details {
+// Trace context of the current thread.
+inline thread_local TraceContext trace_context;
+
+// Trace ids whose hash is below the threshold are sampled. Zero disables sampling.
+inline std::atomic<std::uint64_t> trace_sampling_threshold = 0;
+inline std::atomic<LogLevel> trace_sampling_level = LogLevel::TRACE;
+
+// The top 56 bits of the hash of a trace id are compared with the threshold, so that a ratio of 1 is exact.
+inline constexpr int TRACE_SAMPLING_BITS = 56;
+
+// Finalizer of splitmix64 (Steele et al., "Fast Splittable Pseudorandom Number Generators", OOPSLA 2014): every bit of
+// the input changes every bit of the output with probability close to 1/2.
+constexpr std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+// Hash of a trace id for sampling. Trace ids are not always random (W3C Trace Context level 1, sequential or
+// timestamped generators), so both halves are mixed rather than taking the random part of the id as is.
+constexpr std::uint64_t trace_sampling_hash(const TraceContext& context) {
+    return splitmix64(context.trace_id_low ^ splitmix64(context.trace_id_high)) >> (64 - TRACE_SAMPLING_BITS);
+}
+} // namespace details
+
+// Keep messages down to `level` for a consistent subset of traces: a trace is sampled if the hash of its id is below
+// `ratio` of its range. The decision depends only on the trace id, so every process using the same ratio keeps the same
+// traces. A ratio of zero disables sampling.
+inline void set_trace_sampling(double ratio, LogLevel level = LogLevel::TRACE) {
+    ratio = std::clamp(ratio, 0.0, 1.0);
+    details::trace_sampling_level.store(level, std::memory_order_relaxed);
+    details::trace_sampling_threshold.store(
+        static_cast<std::uint64_t>(ratio * static_cast<double>(std::uint64_t(1) << details::TRACE_SAMPLING_BITS)),
+        std::memory_order_relaxed);
+}
+
+// Whether a trace is selected by trace sampling.
+inline bool is_trace_sampled(const TraceContext& context) {
+    return details::trace_sampling_hash(context) < details::trace_sampling_threshold.load(std::memory_order_relaxed);
+}
+
+// Get the trace context of the current thread.
+inline const TraceContext& current_trace_context() {
+    return details::trace_context;
+}
+
+// Set the trace context of the current thread for the lifetime of the guard. If the trace is sampled, the verbosity
+// of the thread is raised to the sampling level as well.
+class scoped_trace_context {
+public:
+    explicit scoped_trace_context(const TraceContext& context)
+        : previous_(details::trace_context), previous_override_(details::level_override) {
+        details::trace_context = context;
+        if (is_trace_sampled(context)) {
+            details::level_override =
+                std::min(details::level_override, details::trace_sampling_level.load(std::memory_order_relaxed));
+        }
+    }
+
+    ~scoped_trace_context() {
+        details::trace_context = previous_;
+        details::level_override = previous_override_;
+    }
+
+    scoped_trace_context(const scoped_trace_context&) = delete;
+    scoped_trace_context& operator=(const scoped_trace_context&) = delete;
+
+private:
+    TraceContext previous_;
+    LogLevel previous_override_;
+};
+
+// Static description of a log statement. Each LOG_* macro defines one constant-initialized instance, so records
+// only need to carry a pointer to it.
+struct CallSite {
+    LogLevel level;
+    std::string_view format;
+    std::source_location location;
+
+    // Filled in by the writer the first time a record of this call site is written.
+    mutable std::once_flag once;
+    mutable std::string_view prefix; // Rendered "[LEVEL] [file:line] " part of the line, owned by the registry.
+    mutable std::uint32_t id = 0;
+
+    // Constructor.
+    constexpr CallSite(LogLevel level, std::string_view format, std::source_location location)
+        : level(level), format(format), location(location) {}
+
+    CallSite(const CallSite&) = delete;
+    CallSite& operator=(const CallSite&) = delete;
+};
+
+// Registry of the call sites that have been written at least once. The id of a call site is its index. The registry
+// also owns the rendered prefixes.
+class CallSiteRegistry {
+public:
+    // Get the instance of the registry.
+    static CallSiteRegistry& instance() {
+        static CallSiteRegistry registry;
+        return registry;
+    }
+
+    // Register a call site with its rendered prefix and assign its id.
+    void add(const CallSite& site, std::string prefix) {
+        std::lock_guard lock(mutex_);
+        site.id = static_cast<std::uint32_t>(sites_.size());
+        site.prefix = prefixes_.emplace_back(std::move(prefix));
+        sites_.push_back(&site);
+    }
+
+    // Get the call site with the given id, or nullptr if there is none.
+    const CallSite* find(std::uint32_t id) const {
+        std::lock_guard lock(mutex_);
+        return id < sites_.size() ? sites_[id] : nullptr;
+    }
+
+    // Get a snapshot of the registered call sites.
+    std::vector<const CallSite*> sites() const {
+        std::lock_guard lock(mutex_);
+        return sites_;
+    }
+
+private:
+    CallSiteRegistry() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<const CallSite*> sites_;
+    std::deque<std::string> prefixes_; // Elements never move, so the call sites can refer to them.
+};
+
+namespace details {
+// A format string without arguments can only contain escaped braces, so collapse "{{" and "}}" while copying.
+inline void append_literal(std::string& buffer, std::string_view literal) {
+    if (literal.find_first_of("{}") == std::string_view::npos) {
+        buffer += literal;
+        return;
+    }
+    for (std::size_t i = 0; i < literal.size(); ++i) {
+        buffer.push_back(literal[i]);
+        if ((literal[i] == '{' || literal[i] == '}') && i + 1 < literal.size() && literal[i + 1] == literal[i]) {
+            ++i;
+        }
+    }
+}
+} // namespace details
+
+#if MINILOG_HAS_SIGNAL_SAFE
+namespace details {
+// Integer argument of a signal-safe message.
+struct SignalSafeArg {
+    bool negative;
+    std::uint64_t magnitude;
+
+    template<typename Int>
+    static constexpr SignalSafeArg from(Int value) {
+        if constexpr (std::is_signed_v<Int>) {
+            if (value < 0) {
+                return {true, std::uint64_t(0) - static_cast<std::uint64_t>(value)};
+            }
+        }
+        return {false, static_cast<std::uint64_t>(value)};
+    }
+};
+
+// Fixed-size line formatted without allocating, locking or calling anything that is not async-signal-safe. Text
+// that does not fit is cut off.
+class SignalSafeLine {
+public:
+    void append(char c) {
+        if (size_ < sizeof(data_)) {
+            data_[size_++] = c;
+        }
+    }
+
+    void append(std::string_view text) {
+        std::size_t count = std::min(text.size(), sizeof(data_) - size_);
+        if (count != 0) {
+            std::memcpy(data_ + size_, text.data(), count);
+            size_ += count;
+        }
+    }
+
+    // Append an unsigned number with at least `width` digits.
+    void append(std::uint64_t value, int width = 1) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        for (; count < width; ++count) {
+            digits[count] = '0';
+        }
+        while (count > 0) {
+            append(digits[--count]);
+        }
+    }
+
+    void append(const SignalSafeArg& arg) {
+        if (arg.negative) {
+            append('-');
+        }
+        append(arg.magnitude);
+    }
+
+    // Append the local time as "YYYY/MM/DD hh:mm:ss ", from seconds since the epoch including the UTC offset.
+    void append_time(std::int64_t seconds) {
+        std::int64_t days = seconds / 86400;
+        std::int64_t rest = seconds % 86400;
+        if (rest < 0) {
+            rest += 86400;
+            --days;
+        }
+        // Civil date from days since 1970-01-01 (H. Hinnant, "chrono-Compatible Low-Level Date Algorithms").
+        days += 719468;
+        std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        auto day_of_era = static_cast<std::uint64_t>(days - era * 146097);
+        std::uint64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+        std::uint64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+        std::uint64_t mp = (5 * day_of_year + 2) / 153;
+        std::uint64_t day = day_of_year - (153 * mp + 2) / 5 + 1;
+        std::uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+        auto year = static_cast<std::uint64_t>(static_cast<std::int64_t>(year_of_era) + era * 400 + (month <= 2));
+        append(year, 4);
+        append('/');
+        append(month, 2);
+        append('/');
+        append(day, 2);
+        append(' ');
+        append(static_cast<std::uint64_t>(rest / 3600), 2);
+        append(':');
+        append(static_cast<std::uint64_t>(rest / 60 % 60), 2);
+        append(':');
+        append(static_cast<std::uint64_t>(rest % 60), 2);
+        append(' ');
+    }
+
+    // Append a format string, substituting the arguments in order for the replacement fields. Format specs are
+    // ignored and fields without an argument are dropped.
+    void append_message(std::string_view format, std::span<const SignalSafeArg> args) {
+        std::size_t next = 0;
+        for (std::size_t i = 0; i < format.size(); ++i) {
+            char c = format[i];
+            if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+                append(c);
+                ++i;
+            } else if (c == '{') {
+                while (i < format.size() && format[i] != '}') {
+                    ++i;
+                }
+                if (next < args.size()) {
+                    append(args[next++]);
+                }
+            } else {
+                append(c);
+            }
+        }
+    }
+
+    std::string_view view() const {
+        return {data_, size_};
+    }
+
+private:
+    char data_[1024];
+    std::size_t size_ = 0;
+};
+
+// Write all of the data with write(2), retrying on EINTR. Errors are ignored: there is nowhere to report them.
+inline void write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+}
+
+// Number of replacement fields of a format string, to check the arguments of signal-safe messages at compile time.
+constexpr std::size_t replacement_field_count(std::string_view format) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < format.size(); ++i) {
+        if ((format[i] == '{' || format[i] == '}') && i + 1 < format.size() && format[i + 1] == format[i]) {
+            ++i;
+        } else if (format[i] == '{') {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Number of arguments, as a type. Only used in unevaluated operands.
+template<typename... Args>
+std::integral_constant<std::size_t, sizeof...(Args)> argument_count(const Args&...);
+
+// Offset of the local time zone from UTC, in seconds. Not async-signal-safe: it is cached by initialize().
+inline std::int64_t local_utc_offset() {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    if (localtime_r(&now, &local) == nullptr) {
+        return 0;
+    }
+    return local.tm_gmtoff;
+}
+} // namespace details
+#endif
+
+// The maximum number of return addresses captured for a backtrace.
+inline constexpr std::size_t MAX_BACKTRACE_FRAMES = 32;
+
+namespace details {
+#if MINILOG_HAS_BACKTRACE
+struct BacktraceState {
+    void** frames;
+    std::size_t size;
+    std::size_t capacity;
+    std::size_t skip;
+};
+
+inline _Unwind_Reason_Code backtrace_callback(_Unwind_Context* context, void* arg) {
+    auto& state = *static_cast<BacktraceState*>(arg);
+    if (state.skip > 0) {
+        --state.skip;
+        return _URC_NO_REASON;
+    }
+    if (state.size == state.capacity) {
+        return _URC_END_OF_STACK;
+    }
+    auto ip = _Unwind_GetIP(context);
+    if (ip == 0) {
+        return _URC_END_OF_STACK;
+    }
+    state.frames[state.size++] = reinterpret_cast<void*>(ip);
+    return _URC_NO_REASON;
+}
+#endif
+
+// Record the return addresses of the calling thread, without looking up any symbol. Returns the number of frames.
+[[gnu::noinline]] inline std::size_t capture_backtrace(void** frames, std::size_t capacity) {
+#if MINILOG_HAS_BACKTRACE
+    BacktraceState state{frames, 0, capacity, 1}; // Skip this function.
+    _Unwind_Backtrace(backtrace_callback, &state);
+    return state.size;
+#else
+    (void)frames;
+    (void)capacity;
+    return 0;
+#endif
+}
+} // namespace details
+
+// Turns return addresses into "symbol+offset (module)" lines. Every address is looked up once, so repeated stacks
+// only cost hash lookups. Not thread-safe: the writer owns one.
+class BacktraceSymbolizer {
+public:
+    // Append one line per frame to the output.
+    void append(std::string& out, std::span<void* const> frames) {
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            std::format_to(std::back_inserter(out), "    #{} {}\n", i, symbolize(frames[i]));
+        }
+    }
+
+    // Get the description of a return address.
+    std::string_view symbolize(void* address) {
+        auto [it, inserted] = cache_.try_emplace(address);
+        if (inserted) {
+            it->second = __lookup(address);
+        }
+        return it->second;
+    }
+
+private:
+    static std::string __lookup(void* address) {
+#if MINILOG_HAS_BACKTRACE
+        Dl_info info{};
+        if (dladdr(address, &info) != 0) {
+            std::string module = info.dli_fname != nullptr ? info.dli_fname : "?";
+            if (info.dli_sname != nullptr) {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                std::string symbol = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+                std::free(demangled);
+                return std::format("{} {}+{:#x} ({})", address, symbol,
+                                   static_cast<const char*>(address) - static_cast<const char*>(info.dli_saddr),
+                                   module);
+            }
+            return std::format("{} ({}+{:#x})", address, module,
+                               static_cast<const char*>(address) - static_cast<const char*>(info.dli_fbase));
+        }
+#endif
+        return std::format("{}", address);
+    }
+
+    std::unordered_map<void*, std::string> cache_;
+};
+
+// Arguments of a record stored as they are instead of formatted: a function formatting them, and their types with
+// one character per argument (see details::raw_type_code).
+struct RawCodec {
+    void (*format)(std::string& out, std::string_view format, const std::byte* args);
+    std::string_view signature;
+};
+
+namespace details {
+// Code of an argument type in a RawCodec signature, as in Python's struct module: '?' bool, 'c' char, 'b' 'h' 'i' 'q'
+// signed and 'B' 'H' 'I' 'Q' unsigned integers of 1, 2, 4 and 8 bytes, 'f' float, 'd' double, 'g' long double.
+template<typename T>
+constexpr char raw_type_code() {
+    static_assert(std::is_arithmetic_v<T>, "Only arithmetic arguments are stored raw");
+    if constexpr (std::is_same_v<T, bool>) {
+        return '?';
+    } else if constexpr (std::is_same_v<T, char>) {
+        return 'c';
+    } else if constexpr (std::is_integral_v<T>) {
+        static_assert(sizeof(T) <= 8, "Integers of more than 64 bits are not stored raw");
+        constexpr int index = std::bit_width(sizeof(T)) - 1;
+        return std::is_signed_v<T> ? "bhiq"[index] : "BHIQ"[index];
+    } else if constexpr (std::is_same_v<T, float>) {
+        return 'f';
+    } else if constexpr (std::is_same_v<T, double>) {
+        return 'd';
+    } else {
+        return 'g';
+    }
+}
+
+// Size of an argument with the given code.
+constexpr std::size_t raw_type_size(char code) {
+    switch (code) {
+    case 'h':
+    case 'H': return 2;
+    case 'i':
+    case 'I':
+    case 'f': return 4;
+    case 'q':
+    case 'Q':
+    case 'd': return 8;
+    case 'g': return sizeof(long double);
+    default: return 1;
+    }
+}
+
+// Format arguments stored one after the other, unaligned.
+template<typename... Args>
+void format_raw(std::string& out, std::string_view format, const std::byte* data) {
+    std::tuple<Args...> args;
+    std::apply([&](auto&... arg) { ((std::memcpy(&arg, data, sizeof(arg)), data += sizeof(arg)), ...); }, args);
+    std::apply([&](auto&... arg) { std::vformat_to(std::back_inserter(out), format, std::make_format_args(arg...)); },
+               args);
+}
+
+template<typename... Args>
+inline constexpr char raw_signature[] = {raw_type_code<Args>()..., '\0'};
+
+template<typename... Args>
+inline constexpr RawCodec raw_codec{&format_raw<Args...>, {raw_signature<Args...>, sizeof...(Args)}};
+} // namespace details
+
+// Log message as seen by the writer. The text is not owned: it points into the ring buffer, a thread's format
+// buffer or, for constant messages, the static format string of the call site.
+struct LogMessage {
+    const CallSite* site;
+    std::string_view message;
+    bool literal = false; // The message is a format string without arguments, so braces are still escaped.
+    std::chrono::system_clock::time_point time;
+    const TraceContext* trace = nullptr; // Trace context of the logging thread, or nullptr if there was none.
+    std::span<void* const> backtrace;    // Return addresses of the logging thread, if a backtrace was captured.
+    const RawCodec* codec = nullptr;     // Codec of the arguments, if the record kept them raw.
+    const std::byte* args = nullptr;     // The raw arguments. The message is empty if no sink needs it formatted.
+};
+
+// Optional fields of a record, stored between the header and the payload.
+struct RecordExtras {
+    const TraceContext* trace = nullptr;
+    std::span<void* const> backtrace;
+};
+
+// Clock reading the cycle counter of the CPU. Unlike system_clock::now(), it never falls back to a system call.
+struct TscClock {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    static constexpr bool available = true;
+#else
+    static constexpr bool available = false;
+#endif
+
+    // Current value of the cycle counter.
+    static std::uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        std::uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return 0;
+#endif
+    }
+};
+
+// Converts cycle counter readings to system time. The rate of the counter is measured between the anchor taken by
+// anchor() and the time of every conversion, so it gets more accurate the longer the program runs.
+class TscCalibration {
+public:
+    void anchor() {
+        anchor_ticks_ = TscClock::now();
+        anchor_time_ = std::chrono::system_clock::now();
+    }
+
+    std::chrono::system_clock::time_point to_system_time(std::uint64_t ticks) const {
+        std::uint64_t now_ticks = TscClock::now();
+        auto now = std::chrono::system_clock::now();
+        double elapsed_ticks = static_cast<double>(now_ticks - anchor_ticks_);
+        double elapsed_ns = static_cast<double>(std::chrono::nanoseconds(now - anchor_time_).count());
+        double ns_per_tick = elapsed_ticks > 0 && elapsed_ns > 0 ? elapsed_ns / elapsed_ticks : 1.0;
+        // Count back from now: the error is proportional to the age of the reading, not to the uptime.
+        double age = static_cast<double>(static_cast<std::int64_t>(now_ticks - ticks)) * ns_per_tick;
+        return now - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                         std::chrono::nanoseconds(static_cast<std::int64_t>(age)));
+    }
+
+private:
+    std::uint64_t anchor_ticks_ = 0;
+    std::chrono::system_clock::time_point anchor_time_;
+};
+
+// Source of the timestamps of log messages. See the clocks below.
+using ClockFunction = std::chrono::system_clock::time_point (*)() noexcept;
+
+namespace details {
+// Rate of the cycle counter, measured over 10ms on first use, and the reading and time the measurement started at.
+// basic_logger::set_clock() takes the measurement when clocks::tsc is selected, off the path of log statements.
+struct TscRate {
+    std::uint64_t ticks;
+    std::chrono::system_clock::time_point time;
+    double ns_per_tick;
+};
+
+inline const TscRate& tsc_rate() {
+    static const TscRate rate = [] {
+        std::uint64_t ticks = TscClock::now();
+        auto time = std::chrono::system_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        double elapsed_ticks = static_cast<double>(TscClock::now() - ticks);
+        auto elapsed = std::chrono::nanoseconds(std::chrono::system_clock::now() - time);
+        double elapsed_ns = static_cast<double>(elapsed.count());
+        return TscRate{ticks, time, elapsed_ticks > 0 ? elapsed_ns / elapsed_ticks : 1.0};
+    }();
+    return rate;
+}
+} // namespace details
+
+// Clocks that can be passed to basic_logger::set_clock().
+namespace clocks {
+// system_clock::now(): full precision, read through the vDSO on Linux.
+inline std::chrono::system_clock::time_point realtime() noexcept {
+    return std::chrono::system_clock::now();
+}
+
+// CLOCK_REALTIME_COARSE: the time of the last timer tick, so a few milliseconds behind, but several times cheaper to
+// read. The same as realtime() where it is not available.
+inline std::chrono::system_clock::time_point coarse() noexcept {
+#if defined(CLOCK_REALTIME_COARSE)
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec)));
+#else
+    return realtime();
+#endif
+}
+
+// The cycle counter, converted with a rate measured over 10ms when the clock is selected. The cheapest clock, but it
+// drifts away from the system clock and does not follow its adjustments. The same as realtime() without a cycle
+// counter.
+inline std::chrono::system_clock::time_point tsc() noexcept {
+    if constexpr (TscClock::available) {
+        const details::TscRate& calibration = details::tsc_rate();
+        double ns = static_cast<double>(static_cast<std::int64_t>(TscClock::now() - calibration.ticks)) *
+                    calibration.ns_per_tick;
+        return calibration.time + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                      std::chrono::nanoseconds(static_cast<std::int64_t>(ns)));
+    } else {
+        return realtime();
+    }
+}
+} // namespace clocks
+
+// Clock that only moves when told to, so that tests can compare the output byte for byte.
+class ManualClock {
+public:
+    static void set(std::chrono::system_clock::time_point time) {
+        time_.store(time, std::memory_order_relaxed);
+    }
+
+    static void advance(std::chrono::system_clock::duration duration) {
+        set(time_.load(std::memory_order_relaxed) + duration);
+    }
+
+    static std::chrono::system_clock::time_point now() noexcept {
+        return time_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static inline std::atomic<std::chrono::system_clock::time_point> time_{};
+};
+
+// Kind of a record stored in the ring buffer.
+enum class RecordKind : std::uint8_t {
+    PADDING,   // Fills the space up to the end of the buffer when a record does not fit there.
+    FORMATTED, // The formatted message follows the header.
+    LITERAL,   // The message is the format string of the call site. There is no payload.
+    HEAP,      // A pointer to a heap-allocated message follows the header. Used for oversized messages.
+    RAW        // A RawCodec pointer and the raw arguments follow the header. Formatted by the writer.
+};
+
+// Header of a record stored in the ring buffer. The payload follows the header.
+struct RecordHeader {
+    static constexpr std::uint8_t HAS_TRACE_CONTEXT = 1 << 0; // A TraceContext follows the header.
+    static constexpr std::uint8_t TSC_TIME = 1 << 1;          // The time is a TscClock reading.
+
+    std::uint32_t size; // Size of the record in the buffer. Zero until the record is committed.
+    RecordKind kind;
+    std::uint8_t flags;
+    std::uint16_t frames; // Number of return addresses after the trace context.
+    std::uint32_t length; // Length of the message.
+    const CallSite* site;
+    std::chrono::system_clock::time_point time;
+
+    // Size of the optional fields between the header and the payload.
+    static constexpr std::size_t extra_size(const RecordExtras& extras) {
+        return (extras.trace != nullptr ? sizeof(TraceContext) : 0) + extras.backtrace.size_bytes();
+    }
+
+    std::size_t extra_size() const {
+        return ((flags & HAS_TRACE_CONTEXT) ? sizeof(TraceContext) : 0) + frames * sizeof(void*);
+    }
+
+    const TraceContext* trace_context() const {
+        return (flags & HAS_TRACE_CONTEXT) ? reinterpret_cast<const TraceContext*>(this + 1) : nullptr;
+    }
+
+    std::span<void* const> backtrace() const {
+        const std::byte* data = reinterpret_cast<const std::byte*>(this + 1);
+        if (flags & HAS_TRACE_CONTEXT) {
+            data += sizeof(TraceContext);
+        }
+        return {reinterpret_cast<void* const*>(data), frames};
+    }
+
+    std::byte* payload() {
+        return reinterpret_cast<std::byte*>(this + 1) + extra_size();
+    }
+
+    const std::byte* payload() const {
+        return reinterpret_cast<const std::byte*>(this + 1) + extra_size();
+    }
+};
+
+// Byte ring buffer of variable-size records with two-phase reserve/commit. A record is reserved, written in place
+// and committed; the consumer reads committed records in order and zeroes them before releasing the space.
+// Producers reserve space lock-free with a compare-and-swap on the head; consumption must happen on a single thread.
+class RingBuffer {
+public:
+    static constexpr std::size_t ALIGNMENT = alignof(RecordHeader);
+
+    // Default constructor. The buffer has no capacity until a sized buffer is assigned.
+    RingBuffer() = default;
+
+    // Constructor. The capacity is raised to MIN_CAPACITY and rounded up to a power of two.
+    explicit RingBuffer(std::size_t capacity)
+        : capacity_(std::bit_ceil(std::max(capacity, MIN_CAPACITY))),
+          buffer_(std::make_unique<std::byte[]>(capacity_)) {}
+
+    RingBuffer(RingBuffer&& other) noexcept
+        : capacity_(std::exchange(other.capacity_, 0)), buffer_(std::move(other.buffer_)),
+          head_(other.head_.load(std::memory_order_relaxed)), tail_(other.tail_.load(std::memory_order_relaxed)) {}
+
+    RingBuffer& operator=(RingBuffer&& other) noexcept {
+        if (this != &other) {
+            capacity_ = std::exchange(other.capacity_, 0);
+            buffer_ = std::move(other.buffer_);
+            head_.store(other.head_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            tail_.store(other.tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+
+    // Size of a record with the given payload size in the buffer.
+    static constexpr std::size_t record_size(std::size_t payload_size) {
+        return (sizeof(RecordHeader) + payload_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    // The smallest capacity. Its largest record holds the biggest record of fixed size: a trace context, a full
+    // backtrace and the pointer to a message on the heap.
+    static const std::size_t MIN_CAPACITY;
+
+    // The largest record accepted; bigger messages go to the heap so that one record cannot starve the others.
+    std::size_t max_record_size() const {
+        return capacity_ / 4;
+    }
+
+    // Reserve a record of the given size. Returns nullptr if there is not enough free space, or if the reservation
+    // lost the race against other producers `max_attempts` times.
+    RecordHeader* try_reserve(std::size_t size, std::size_t max_attempts = SIZE_MAX) {
+        std::uint64_t head = head_.load(std::memory_order_relaxed);
+        std::size_t offset;
+        std::size_t to_end;
+        do {
+            std::uint64_t tail = tail_.load(std::memory_order_acquire);
+            offset = head & (capacity_ - 1);
+            to_end = capacity_ - offset;
+            std::size_t required = size <= to_end ? size : to_end + size;
+            if (head + required - tail > capacity_) {
+                return nullptr;
+            }
+            if (head_.compare_exchange_weak(head, head + required, std::memory_order_relaxed)) {
+                break;
+            }
+            if (--max_attempts == 0) {
+                return nullptr;
+            }
+        } while (true);
+        if (size > to_end) {
+            auto* padding = reinterpret_cast<RecordHeader*>(buffer_.get() + offset);
+            padding->kind = RecordKind::PADDING;
+            std::atomic_ref(padding->size).store(static_cast<std::uint32_t>(to_end), std::memory_order_release);
+            offset = 0;
+        }
+        return reinterpret_cast<RecordHeader*>(buffer_.get() + offset);
+    }
+
+    // Publish a reserved record to the consumer.
+    static void commit(RecordHeader* record, std::size_t size) {
+        std::atomic_ref(record->size).store(static_cast<std::uint32_t>(size), std::memory_order_release);
+    }
+
+    // Whether the next record is committed and can be consumed.
+    bool readable() const {
+        if (!buffer_) {
+            return false;
+        }
+        auto* record = reinterpret_cast<RecordHeader*>(buffer_.get() + (tail_.load(std::memory_order_relaxed) & (capacity_ - 1)));
+        return std::atomic_ref(record->size).load(std::memory_order_acquire) != 0;
+    }
+
+    // Bytes reserved since the buffer was created.
+    std::uint64_t reserved_bytes() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    // Bytes consumed since the buffer was created.
+    std::uint64_t consumed_bytes() const {
+        return tail_.load(std::memory_order_acquire);
+    }
+
+    // Consume up to `budget` committed records in order. Returns the number of records consumed.
+    template<typename F>
+    std::size_t consume(F&& f, std::size_t budget = SIZE_MAX) {
+        if (!buffer_) {
+            return 0;
+        }
+        std::size_t consumed = 0;
+        std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        while (consumed < budget) {
+            std::byte* data = buffer_.get() + (tail & (capacity_ - 1));
+            auto* record = reinterpret_cast<RecordHeader*>(data);
+            std::uint32_t size = std::atomic_ref(record->size).load(std::memory_order_acquire);
+            if (size == 0) {
+                break;
+            }
+            if (record->kind != RecordKind::PADDING) {
+                f(*record);
+                ++consumed;
+            }
+            std::memset(data, 0, size);
+            tail += size;
+            tail_.store(tail, std::memory_order_release);
+        }
+        return consumed;
+    }
+
+private:
+    std::size_t capacity_ = 0;
+    std::unique_ptr<std::byte[]> buffer_;
+    std::atomic<std::uint64_t> head_ = 0; // Reservation position, shared by the producers.
+    std::atomic<std::uint64_t> tail_ = 0; // Consumption position, owned by the consumer.
+};
+
+inline constexpr std::size_t RingBuffer::MIN_CAPACITY =
+    std::bit_ceil(4 * record_size(sizeof(TraceContext) + MAX_BACKTRACE_FRAMES * sizeof(void*) + sizeof(char*)));
+
+// Mutex that does nothing, for loggers used by a single thread.
+struct NullMutex {
+    void lock() {}
+    bool try_lock() {
+        return true;
+    }
+    void unlock() {}
+};
+
+// Threading policy of a logger that is used by several threads.
+struct MultiThreaded {
+    using mutex_type = std::mutex;
+};
+
+// Threading policy of a logger that is used by a single thread. No locks are taken.
+struct SingleThreaded {
+    using mutex_type = NullMutex;
+};
+
+// Queue policy without a queue: messages are always written by the calling thread.
+struct SyncQueue {
+    static constexpr bool asynchronous = false;
+};
+
+// Queue policy with a ring buffer: messages can be queued and written by a backend thread.
+struct RingQueue {
+    static constexpr bool asynchronous = true;
+};
+
+// Queue policy for real-time threads. LOG_RT_* statements are wait-free: they store their arithmetic arguments in the
+// ring buffer without formatting, allocating, locking or making system calls, and drop the message if there is no
+// space. The backend polls the ring buffer instead of being woken up.
+struct RealtimeRingQueue {
+    static constexpr bool asynchronous = true;
+    static constexpr bool realtime = true;
+    static constexpr std::chrono::microseconds poll_interval{500};
+};
+
+// A call site and its estimated number of records in a time window.
+struct HeavyHitter {
+    const CallSite* site = nullptr;
+    std::uint64_t count = 0;
+};
+
+// The call sites with the most records in a time window, most frequent first.
+struct HeavyHitterReport {
+    static constexpr std::size_t MAX_SITES = 16;
+
+    std::chrono::system_clock::time_point start;
+    std::chrono::system_clock::duration window{};
+    std::array<HeavyHitter, MAX_SITES> sites{};
+    std::size_t size = 0;
+};
+
+// Finds the call sites that log the most in each time window: a Count-Min sketch (Cormode and Muthukrishnan, 2005)
+// of the records per call site, and the top call sites by estimated count. The sketch takes a fixed amount of memory
+// however many call sites there are, and its estimates only err upwards. Its counters are relaxed atomics, so that
+// writers on several threads count without a lock; the mutex is only taken to start a new window or to let a call
+// site into the top ones. Records counted while a window is being started can be attributed to either window.
+class HeavyHitters {
+public:
+    static constexpr std::size_t DEPTH = 4;
+    static constexpr std::size_t WIDTH = 1024;
+
+    // Constructor. Keeps the top `top` call sites, up to HeavyHitterReport::MAX_SITES.
+    HeavyHitters(std::chrono::system_clock::duration window, std::size_t top)
+        : window_(window), top_(std::min(top, HeavyHitterReport::MAX_SITES)), threshold_(__empty_threshold()) {}
+
+    // Count a record. Returns true if the record started a new window, so that the report of the previous one is
+    // ready.
+    bool add(const CallSite& site, std::chrono::system_clock::time_point time) {
+        bool rotated = false;
+        if (time - start_.load(std::memory_order_acquire) >= window_) {
+            rotated = __rotate(time);
+        }
+        std::uint64_t estimate = UINT64_MAX;
+        for (std::size_t row = 0; row < DEPTH; ++row) {
+            auto& counter = counters_[row][__column(site, row)];
+            estimate = std::min(estimate, counter.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+        if (estimate > threshold_.load(std::memory_order_relaxed) && !__in_top(site)) {
+            __update_top(site, estimate);
+        }
+        return rotated;
+    }
+
+    // Estimated number of records of a call site in the current window. Zero for a call site that has not logged.
+    std::uint64_t estimate(const CallSite& site) const {
+        return __estimate(site);
+    }
+
+    // The heaviest call sites of the last complete window.
+    HeavyHitterReport report() const {
+        std::lock_guard lock(mutex_);
+        return last_;
+    }
+
+private:
+    // Multiply-shift hashing of the address of the call site, with a different odd multiplier per row. The address is
+    // known before the call site has been written and given an id.
+    static std::size_t __column(const CallSite& site, std::size_t row) {
+        static constexpr std::uint64_t MULTIPLIERS[DEPTH] = {0x9e3779b97f4a7c15, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9,
+                                                             0xd6e8feb86659fd93};
+        auto key = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&site));
+        return static_cast<std::size_t>(key * MULTIPLIERS[row] >> (64 - std::bit_width(WIDTH - 1)));
+    }
+
+    std::uint64_t __estimate(const CallSite& site) const {
+        std::uint64_t estimate = UINT64_MAX;
+        for (std::size_t row = 0; row < DEPTH; ++row) {
+            estimate = std::min(estimate, counters_[row][__column(site, row)].load(std::memory_order_relaxed));
+        }
+        return estimate;
+    }
+
+    // Estimate above which a call site may enter the top ones: none is needed while there is a free place.
+    std::uint64_t __empty_threshold() const {
+        return top_ == 0 ? UINT64_MAX : 0;
+    }
+
+    bool __in_top(const CallSite& site) const {
+        for (std::size_t i = 0; i < top_; ++i) {
+            if (top_sites_[i].load(std::memory_order_relaxed) == &site) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Take a free place in the top call sites, or the place of the one with the smallest estimate if this one is
+    // larger, and raise the threshold to the new smallest estimate.
+    void __update_top(const CallSite& site, std::uint64_t estimate) {
+        std::lock_guard lock(mutex_);
+        std::size_t smallest = 0;
+        std::uint64_t smallest_estimate = UINT64_MAX;
+        for (std::size_t i = 0; i < top_; ++i) {
+            const CallSite* other = top_sites_[i].load(std::memory_order_relaxed);
+            if (other == &site) {
+                return; // Added by another writer.
+            }
+            std::uint64_t other_estimate = other != nullptr ? __estimate(*other) : 0;
+            if (other_estimate < smallest_estimate) {
+                smallest = i;
+                smallest_estimate = other_estimate;
+            }
+        }
+        if (estimate > smallest_estimate) {
+            top_sites_[smallest].store(&site, std::memory_order_relaxed);
+            smallest_estimate = estimate;
+            for (std::size_t i = 0; i < top_; ++i) {
+                const CallSite* other = top_sites_[i].load(std::memory_order_relaxed);
+                smallest_estimate = std::min(smallest_estimate, other != nullptr ? __estimate(*other) : 0);
+            }
+        }
+        threshold_.store(smallest_estimate, std::memory_order_relaxed);
+    }
+
+    // Publish the report of the current window and start a new one. Returns whether there was a window to report,
+    // or false if another writer has just started the new window.
+    bool __rotate(std::chrono::system_clock::time_point time) {
+        std::lock_guard lock(mutex_);
+        std::chrono::system_clock::time_point start = start_.load(std::memory_order_relaxed);
+        if (time - start < window_) {
+            return false;
+        }
+        HeavyHitterReport report;
+        report.start = start;
+        report.window = window_;
+        for (std::size_t i = 0; i < top_; ++i) {
+            if (const CallSite* site = top_sites_[i].exchange(nullptr, std::memory_order_relaxed)) {
+                report.sites[report.size++] = {site, __estimate(*site)};
+            }
+        }
+        std::sort(report.sites.begin(), report.sites.begin() + report.size,
+                  [](const HeavyHitter& a, const HeavyHitter& b) { return a.count > b.count; });
+        last_ = report;
+        for (auto& row : counters_) {
+            for (auto& counter : row) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+        }
+        threshold_.store(__empty_threshold(), std::memory_order_relaxed);
+        start_.store(time, std::memory_order_release);
+        return start != std::chrono::system_clock::time_point();
+    }
+
+    std::chrono::system_clock::duration window_;
+    std::size_t top_;
+    std::array<std::array<std::atomic<std::uint64_t>, WIDTH>, DEPTH> counters_{};
+    std::array<std::atomic<const CallSite*>, HeavyHitterReport::MAX_SITES> top_sites_{}; // Not sorted.
+    std::atomic<std::uint64_t> threshold_;                       // Smallest estimate of the top call sites.
+    std::atomic<std::chrono::system_clock::time_point> start_{}; // Start of the current window.
+    HeavyHitterReport last_;
+    mutable std::mutex mutex_; // Guards last_, and changes of the top call sites and of the window.
+};
+
+// Who writes the messages of a logger.
+enum class BackendMode {
+    NONE,   // Synchronous logging: the calling thread writes each message.
+    THREAD, // Messages are queued and written by a backend thread.
+    MANUAL  // Messages are queued and written when the application calls poll(), e.g. from its event loop.
+};
+
+// Sink writing lines to the console.
+class ConsoleSink {
+public:
+    // Enable or disable output to the console.
+    void enable(bool enable = true) {
+        enabled_.store(enable, std::memory_order_relaxed);
+    }
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Set the log level threshold for console output.
+    void set_level_threshold(LogLevel level) {
+        level_threshold_.store(level, std::memory_order_relaxed);
+    }
+
+    LogLevel level_threshold() const {
+        return level_threshold_.load(std::memory_order_relaxed);
+    }
+
+    void write(const LogMessage& message, std::string_view line) {
+        if (enabled() && message.site->level >= level_threshold()) {
+            std::cout << line;
+        }
+    }
+
+private:
+    std::atomic<bool> enabled_ = true;
+    std::atomic<LogLevel> level_threshold_ = LogLevel::INFO; // Default log level threshold for console output.
+};
+
+// Sink writing lines to a file.
+class FileSink {
+public:
+    void open(const std::string& file_name) {
+        file_.open(file_name, std::ios::app);
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open log file");
+        }
+#if !defined(NDEBUG)
+        std::cout << "Log file: " << file_name << std::endl;
+#endif
+    }
+
+    void write(const LogMessage&, std::string_view line) {
+        file_ << line;
+        file_.flush();
+#if !defined(NDEBUG)
+        std::cout << "Message has been written to the log file" << std::endl;
+#endif
+    }
+
+    void close() {
+        if (file_.is_open()) {
+            file_.close();
+#if !defined(NDEBUG)
+            std::cout << "Log file has been closed" << std::endl;
+#endif
+        }
+    }
+
+private:
+    std::ofstream file_;
 };
 
-// Log message.
-struct LogMessage {
-    LogLevel level;
-    std::string message;
-    std::source_location location;
-    std::chrono::system_clock::time_point time;
+// File sink giving every thread its own file: <stem>.<thread id><extension> for the file name passed to initialize(),
+// e.g. app.4242.log for app.log. A thread opens its file with its first line and closes it when it exits or the sink
+// is closed. initialize() checks that the file of the calling thread can be created, so that a bad path is reported
+// there, but leaves no file behind. Since no state is shared between threads, a synchronous logger whose sinks are
+// all thread-safe writes without taking its mutex. The lines must be written by the threads that log them, so the
+// sink cannot be used with a backend.
+class PerThreadFileSink {
+public:
+    static constexpr bool thread_safe = true;
 
-    // Default constructor.
-    LogMessage() = default;
+    void open(const std::string& file_name) {
+        {
+            std::lock_guard lock(path_mutex_);
+            path_ = file_name;
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+        ThreadFile* file = __thread_file();
+        if (file == nullptr) {
+            return;
+        }
+        std::lock_guard lock(file->mutex);
+        std::string path = __thread_path(file_name);
+        std::error_code error;
+        bool existed = std::filesystem::exists(path, error);
+        if (!__reopen(*file)) {
+            throw std::runtime_error("Failed to open log file");
+        }
+        if (!existed) {
+            // Opened again by the first line of the thread, if there is one.
+            file->stream.close();
+            file->generation = UINT64_MAX;
+            std::filesystem::remove(path, error);
+        }
+    }
 
-    // Constructor.
-    LogMessage(LogLevel level, std::string message, std::source_location location)
-        : level(level), message(std::move(message)), location(location), time(std::chrono::system_clock::now()) {}
+    // Lines of a thread whose file cannot be opened are dropped until the next rotate().
+    void write(const LogMessage&, std::string_view line) {
+        ThreadFile* file = __thread_file();
+        if (file == nullptr) {
+            return;
+        }
+        // Only contended while the sink is closing.
+        std::lock_guard lock(file->mutex);
+        if (file->generation != generation_.load(std::memory_order_acquire)) {
+            __reopen(*file);
+        }
+        if (file->stream.is_open()) {
+            file->stream << line;
+            file->stream.flush();
+        }
+    }
 
-    // Copy constructor.
-    LogMessage(const LogMessage& other)
-        : level(other.level), message(other.message), location(other.location), time(other.time) {}
+    // Make every thread reopen its file with its next line, e.g. after the files have been moved away for rotation.
+    void rotate() {
+        std::lock_guard lock(path_mutex_);
+        generation_.fetch_add(1, std::memory_order_release);
+    }
 
-    // Copy assignment operator.
-    LogMessage& operator=(const LogMessage& other) {
-        if (this != &other) {
-            level = other.level;
-            message = other.message;
-            location = other.location;
-            time = other.time;
+    // Close the files of every thread. Lines written after that are dropped until the sink is opened again.
+    void close() {
+        {
+            std::lock_guard lock(path_mutex_);
+            path_.clear();
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+        std::lock_guard lock(files_mutex_);
+        for (const std::weak_ptr<ThreadFile>& weak : files_) {
+            if (std::shared_ptr<ThreadFile> file = weak.lock()) {
+                std::lock_guard file_lock(file->mutex);
+                file->stream.close();
+            }
+        }
+        std::erase_if(files_, [](const std::weak_ptr<ThreadFile>& file) { return file.expired(); });
+        if (ThreadFiles* files = __thread_files()) {
+            std::erase_if(files->files, [this](const auto& file) { return file.first == id_; });
         }
-        return *this;
     }
 
-    // Move constructor.
-    LogMessage(LogMessage&& other) noexcept
-        : level(other.level), message(std::move(other.message)), location(other.location), time(other.time) {}
+private:
+    // File of a thread for one sink. Owned by the thread, and seen by the sink so that close() can reach it.
+    struct ThreadFile {
+        std::mutex mutex;             // Guards the file against close() from another thread.
+        std::uint64_t generation = 0; // generation_ of the sink when the file was opened.
+        std::ofstream stream;
+    };
 
-    // Move assignment operator.
-    LogMessage& operator=(LogMessage&& other) noexcept {
-        if (this != &other) {
-            level = other.level;
-            message = std::move(other.message);
-            location = other.location;
-            time = other.time;
+    // Files of a thread by id_ of their sink. Marks them destroyed at thread exit, when a logger destroyed later can
+    // still close its sinks.
+    struct ThreadFiles {
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<ThreadFile>>> files;
+
+        ~ThreadFiles() {
+            destroyed = true;
         }
-        return *this;
+
+        static inline thread_local bool destroyed = false;
+    };
+
+    // Open the file of the current thread again with the current path. Returns whether it is open.
+    bool __reopen(ThreadFile& file) const {
+        std::string path;
+        {
+            // The path and the generation are read together, so that a file is never opened with a stale path under a
+            // new generation.
+            std::lock_guard lock(path_mutex_);
+            path = path_;
+            file.generation = generation_.load(std::memory_order_relaxed);
+        }
+        file.stream.close();
+        file.stream.clear();
+        if (!path.empty()) {
+            file.stream.open(__thread_path(path), std::ios::app);
+        }
+        return file.stream.is_open();
+    }
+
+    static std::string __thread_path(const std::string& path) {
+#if defined(__linux__)
+        auto id = static_cast<std::uint64_t>(::syscall(SYS_gettid));
+#else
+        auto id = static_cast<std::uint64_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+#endif
+        std::size_t slash = path.find_last_of("/\\");
+        std::size_t dot = path.rfind('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return std::format("{}.{}", path, id);
+        }
+        return std::format("{}.{}{}", path.substr(0, dot), id, path.substr(dot));
+    }
+
+    // The file of the current thread for this sink, or nullptr once the thread is exiting. Sinks are told apart by id
+    // rather than by address, since a new sink can take the address of a destroyed one.
+    ThreadFile* __thread_file() {
+        ThreadFiles* files = __thread_files();
+        if (files == nullptr) {
+            return nullptr;
+        }
+        for (auto& [sink, file] : files->files) {
+            if (sink == id_) {
+                return file.get();
+            }
+        }
+        auto file = std::make_shared<ThreadFile>();
+        file->generation = UINT64_MAX;
+        {
+            std::lock_guard lock(files_mutex_);
+            std::erase_if(files_, [](const std::weak_ptr<ThreadFile>& file) { return file.expired(); });
+            files_.push_back(file);
+        }
+        return files->files.emplace_back(id_, std::move(file)).second.get();
     }
+
+    static ThreadFiles* __thread_files() {
+        static thread_local ThreadFiles files;
+        return ThreadFiles::destroyed ? nullptr : &files;
+    }
+
+    static inline std::atomic<std::uint64_t> next_id_ = 1;
+
+    const std::uint64_t id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+    mutable std::mutex path_mutex_; // Guards path_, and changes of generation_.
+    std::string path_;
+    std::atomic<std::uint64_t> generation_ = 0;    // Changed to make the threads reopen their files.
+    std::mutex files_mutex_;                       // Guards files_.
+    std::vector<std::weak_ptr<ThreadFile>> files_; // Files of the threads that have written with this sink.
 };
 
-// Logger class.
-class Logger {
+// A sink that can be written by several threads at once, without the mutex of the logger.
+template<typename Sink>
+concept ThreadSafeSink = requires { requires Sink::thread_safe; };
+
+// A sink that reads the raw arguments of the records that kept them (see LogMessage::codec) instead of the message.
+template<typename Sink>
+concept RawArgumentSink = requires { requires Sink::raw_arguments; };
+
+// A sink flushed after every record of a synchronous logger, which never ends the batches the sink waits for.
+template<typename Sink>
+concept RecordFlushSink = requires { requires Sink::flush_each_record; };
+
+// A sink that receives the rendered line. Other sinks receive only the message and do their own encoding.
+template<typename Sink>
+concept LineSink = requires(Sink& sink, const LogMessage& message, std::string_view line) { sink.write(message, line); };
+
+// Logger with compile-time threading policy, queue policy and set of sinks. Every sink is called directly, without
+// virtual dispatch.
+template<typename ThreadingPolicy, typename QueuePolicy, typename... Sinks>
+class basic_logger {
 public:
+    using mutex_type = typename ThreadingPolicy::mutex_type;
+
+    // Whether the logger has a sink of the given type.
+    template<typename Sink>
+    static constexpr bool has_sink = (std::is_same_v<Sink, Sinks> || ...);
+
     // Get the instance of the logger.
-    static Logger& instance() {
-        static Logger logger;
+    static basic_logger& instance() {
+        static basic_logger logger;
         return logger;
     }
 
     // Initialize the logger.
     void initialize(const std::string& file_name, LogLevel level_threshold = LogLevel::INFO, bool async = false) {
+        initialize(file_name, level_threshold, async ? BackendMode::THREAD : BackendMode::NONE);
+    }
+
+    // Initialize the logger with the given backend.
+    void initialize(const std::string& file_name, LogLevel level_threshold, BackendMode backend) {
         std::lock_guard lock(mutex_);
-        if (initialized_) {
+        if (initialized_.load(std::memory_order_relaxed)) {
             throw std::runtime_error("Logger already initialized");
         }
-        file_name_ = file_name;
-        level_threshold_ = level_threshold;
+        bool async = backend != BackendMode::NONE;
+        if (async && !QueuePolicy::asynchronous) {
+            throw std::runtime_error("Asynchronous logging requires a queue");
+        }
+        if (backend == BackendMode::THREAD && std::is_same_v<mutex_type, NullMutex>) {
+            throw std::runtime_error("A backend thread requires a multi-threaded logger");
+        }
+        if (realtime_queue && !async) {
+            throw std::runtime_error("A real-time queue requires a backend");
+        }
+        if (async && has_sink<PerThreadFileSink>) {
+            throw std::runtime_error("Per-thread log files require synchronous logging");
+        }
         async_ = async;
+        backend_ = backend;
+        if constexpr (has_sink<ConsoleSink>) {
+            sink<ConsoleSink>().set_level_threshold(level_threshold);
+#if !defined(NDEBUG)
+            std::cout << "The log level threshold for console output: " << to_string(level_threshold) << '\n';
+            std::cout << "Output to console: " << (sink<ConsoleSink>().enabled() ? "true" : "false") << '\n';
+#endif
+        }
 #if !defined(NDEBUG)
-        std::cout << "The log level threshold for console output: " << __log_level_to_string(level_threshold_) << '\n';
-        std::cout << "Output to console: " << (enable_output_to_console_ ? "true" : "false") << '\n';
         std::cout << "Asynchronous logging: " << (async ? "true" : "false") << '\n';
+        std::cout << "Manual backend: " << (backend == BackendMode::MANUAL ? "true" : "false") << '\n';
+#endif
+        std::apply([&](auto&... sinks) { (__open_sink(sinks, file_name), ...); }, sinks_);
+        if (heavy_hitter_window_ != std::chrono::system_clock::duration::zero()) {
+            heavy_hitters_ = std::make_unique<HeavyHitters>(heavy_hitter_window_, heavy_hitter_top_);
+        } else {
+            heavy_hitters_.reset();
+        }
+#if MINILOG_HAS_SIGNAL_SAFE
+        utc_offset_.store(details::local_utc_offset(), std::memory_order_relaxed);
+        if constexpr (has_sink<FileSink>) {
+            // Separate descriptor for signal handlers. O_APPEND keeps their lines whole next to the ones of the sink.
+            signal_fd_.store(::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644),
+                             std::memory_order_release);
+        }
 #endif
-        __open_log_file();
-        if (async_) {
-            thread_ = std::jthread(&Logger::__process_messages, this);
+        if constexpr (QueuePolicy::asynchronous) {
+            if (async_) {
+                ring_ = RingBuffer(queue_capacity_);
+                flushed_bytes_.store(0, std::memory_order_relaxed);
+                tsc_.anchor();
+            }
+            if (backend_ == BackendMode::THREAD) {
+                thread_ = std::jthread([this](std::stop_token st) { __process_messages(st); });
+            }
         }
-        initialized_ = true;
+        initialized_.store(true, std::memory_order_release);
 #if !defined(NDEBUG)
         std::cout << "Logger has been initialized" << std::endl;
 #endif
     }
 
-    // Log a message with the specified log level and format string.
+    // Whether a message of the given level passes the log level threshold, or the override of the current thread.
+    bool should_log(LogLevel level) const {
+        return level >= std::min(level_.load(std::memory_order_relaxed), details::level_override);
+    }
+
+    // Set the log level threshold. Messages below it are dropped before they are formatted. Default is TRACE.
+    void set_log_level(LogLevel level) {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    LogLevel log_level() const {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    // Set the clock of the timestamps, e.g. clocks::coarse when millisecond precision is enough, or ManualClock::now
+    // in tests. Real-time and signal-safe statements keep their own clocks. Selecting clocks::tsc measures the rate of
+    // the cycle counter on the calling thread, so that no log statement has to wait for the measurement.
+    void set_clock(ClockFunction clock) {
+        if (clock == &clocks::tsc) {
+            details::tsc_rate();
+        }
+        clock_.store(clock, std::memory_order_relaxed);
+    }
+
+    // Capture a backtrace for messages at or above the given level. The logging thread only records return
+    // addresses; symbols are looked up by the writer. Disabled by default.
+    void set_backtrace_level(LogLevel level) {
+        backtrace_level_.store(level, std::memory_order_relaxed);
+    }
+
+    // Do not capture backtraces.
+    void disable_backtrace() {
+        backtrace_level_.store(BACKTRACE_DISABLED, std::memory_order_relaxed);
+    }
+
+    // Log a message of the specified call site. The format string is the one of the call site. The LOG_* macros
+    // check should_log() first, so the arguments of dropped messages are not evaluated.
     template<typename... Args>
-    void log(std::source_location location, LogLevel level, std::format_string<Args...> fmt, Args&&... args) {
-        std::lock_guard lock(mutex_);
-        if (!initialized_) {
+    void log(const CallSite& site, std::format_string<Args...> fmt, Args&&... args) {
+        if (!initialized_.load(std::memory_order_acquire)) {
             throw std::runtime_error("Logger not initialized");
         }
-        if (async_) {
-            messages_.emplace(level, std::format(fmt, std::forward<Args>(args)...), location);
-            cv_.notify_one();
-        } else {
-            LogMessage message(level, std::format(fmt, std::forward<Args>(args)...), location);
-            __write_log_message(message);
+        auto time = clock_.load(std::memory_order_relaxed)();
+        RecordExtras extras;
+        if (!details::trace_context.empty()) {
+            extras.trace = &details::trace_context;
         }
+        void* frames[MAX_BACKTRACE_FRAMES];
+        if (site.level >= backtrace_level_.load(std::memory_order_relaxed)) {
+            // Only the raw return addresses are recorded here; the writer looks up the symbols.
+            extras.backtrace = {frames, details::capture_backtrace(frames, MAX_BACKTRACE_FRAMES)};
+        }
+        if (!QueuePolicy::asynchronous || !async_) {
+            if constexpr (lock_free_sinks) {
+                // Every sink keeps per-thread state, so each thread writes with its own buffers and without the mutex.
+                __write_sync(__thread_writer(), site, time, extras, fmt, std::forward<Args>(args)...);
+            } else {
+                std::lock_guard lock(mutex_);
+                __write_sync(writer_, site, time, extras, fmt, std::forward<Args>(args)...);
+                if constexpr (flushes_records) {
+                    std::apply([](auto&... sinks) { (__flush_record(sinks), ...); }, sinks_);
+                }
+            }
+            return;
+        }
+        if constexpr (QueuePolicy::asynchronous) {
+            std::size_t extra = RecordHeader::extra_size(extras);
+            if constexpr (sizeof...(Args) == 0) {
+                std::size_t size = RingBuffer::record_size(extra);
+                __commit(__reserve(size, extras), size, RecordKind::LITERAL, site, 0, time);
+            } else if constexpr (keeps_raw_arguments<Args...>) {
+                // A sink encodes the arguments itself: copy them as they are and leave the formatting to the writer.
+                constexpr std::size_t length = sizeof(const RawCodec*) + (sizeof(std::remove_cvref_t<Args>) + ...);
+                std::size_t size = RingBuffer::record_size(extra + length);
+                if (size > ring_.max_record_size()) {
+                    // Too many arguments for the ring buffer: formatted like any other oversized message.
+                    __enqueue_formatted(site, time, extras, fmt, std::forward<Args>(args)...);
+                    return;
+                }
+                RecordHeader* record = __reserve(size, extras);
+                __store_raw(record->payload(), args...);
+                __commit(record, size, RecordKind::RAW, site, length, time);
+            } else {
+                __enqueue_formatted(site, time, extras, fmt, std::forward<Args>(args)...);
+            }
+        }
+    }
+
+#if MINILOG_HAS_SIGNAL_SAFE
+    // Log from a signal handler. The message is formatted on the stack and written with a single write(2) to the log
+    // file, or to stderr if there is none, bypassing the queue, the mutex and the sinks. Only integer arguments are
+    // supported. The local time uses the UTC offset of the time the logger was initialized.
+    template<typename... Ints>
+    void log_signal_safe(const CallSite& site, Ints... values) noexcept {
+        static_assert((std::is_integral_v<Ints> && ...), "Signal-safe messages only take integer arguments");
+        int saved_errno = errno;
+        details::SignalSafeLine line;
+        timespec now{};
+        clock_gettime(CLOCK_REALTIME, &now);
+        line.append_time(static_cast<std::int64_t>(now.tv_sec) + utc_offset_.load(std::memory_order_relaxed));
+        line.append('[');
+        line.append(to_string(site.level));
+        line.append("] [");
+        line.append(std::string_view(site.location.file_name()));
+        line.append(':');
+        line.append(std::uint64_t(site.location.line()));
+        line.append("] ");
+        const details::SignalSafeArg args[sizeof...(Ints) + 1] = {details::SignalSafeArg::from(values)..., {}};
+        line.append_message(site.format, std::span(args, sizeof...(Ints)));
+        line.append('\n');
+        int fd = signal_fd_.load(std::memory_order_acquire);
+        details::write_all(fd >= 0 ? fd : STDERR_FILENO, line.view());
+        errno = saved_errno;
+    }
+
+    // Get the instance of the logger from a signal handler, or nullptr if instance() has not constructed it yet.
+    // Unlike instance(), it does not go through the initialization guard of a static local, which may take a lock.
+    static basic_logger* signal_safe_instance() noexcept {
+        return signal_safe_instance_.load(std::memory_order_acquire);
+    }
+#endif
+
+    // Log a message from a real-time thread. Requires a real-time queue. The arguments must be arithmetic; they are
+    // copied into the ring buffer together with a function formatting them, and the writer does the formatting. The
+    // time is read from the cycle counter. Nothing blocks, allocates or makes a system call: if the ring buffer stays
+    // contended or is full, the message is dropped and counted.
+    template<typename... Args>
+    void log_rt(const CallSite& site, std::format_string<Args...>, Args... args) noexcept {
+        static_assert(realtime_queue, "Real-time logging requires a real-time queue policy");
+        static_assert((std::is_arithmetic_v<Args> && ...), "Real-time messages only take arithmetic arguments");
+        static_assert(TscClock::available, "Real-time logging requires a cycle counter");
+        if constexpr (realtime_queue) {
+            std::uint64_t ticks = TscClock::now();
+            if (!initialized_.load(std::memory_order_acquire)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            RecordExtras extras;
+            if (!details::trace_context.empty()) {
+                extras.trace = &details::trace_context;
+            }
+            constexpr std::size_t length = sizeof(const RawCodec*) + (sizeof(Args) + ... + 0);
+            std::size_t size = RingBuffer::record_size(RecordHeader::extra_size(extras) + length);
+            RecordHeader* record = ring_.try_reserve(size, REALTIME_RESERVE_ATTEMPTS);
+            if (record == nullptr) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            __store_extras(record, extras);
+            record->flags |= RecordHeader::TSC_TIME;
+            __store_raw(record->payload(), args...);
+            __publish(record, size, RecordKind::RAW, site, length,
+                      std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks)));
+        }
+    }
+
+    // Number of real-time messages dropped because the ring buffer was full or contended.
+    std::uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    // Write up to `budget` queued messages on the calling thread. Requires the manual backend. Returns the number of
+    // messages written.
+    std::size_t poll(std::size_t budget = SIZE_MAX)
+        requires(QueuePolicy::asynchronous)
+    {
+        if (backend_ != BackendMode::MANUAL) {
+            throw std::runtime_error("poll() requires the manual backend");
+        }
+        return __pump(budget);
+    }
+
+    // Wait until the messages queued before the call have been written and the sinks flushed, e.g. before reading the
+    // log file. With the manual backend, the messages are written on the calling thread. Does nothing when logging
+    // synchronously.
+    void flush() {
+        if constexpr (QueuePolicy::asynchronous) {
+            if (!async_) {
+                return;
+            }
+            if (backend_ == BackendMode::MANUAL) {
+                __pump(SIZE_MAX);
+                return;
+            }
+            std::uint64_t queued = ring_.reserved_bytes();
+            while (flushed_bytes_.load(std::memory_order_acquire) < queued) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    // Get a sink of the logger.
+    template<typename Sink>
+    Sink& sink() {
+        return std::get<Sink>(sinks_);
     }
 
     // Enable or disable output to the console.
-    void enable_output_to_console(bool enable = true) {
+    void enable_output_to_console(bool enable = true)
+        requires(has_sink<ConsoleSink>)
+    {
+        sink<ConsoleSink>().enable(enable);
+    }
+
+    // Set the size of the ring buffer used for asynchronous logging. Takes effect on the next initialization. Sizes
+    // below RingBuffer::MIN_CAPACITY are raised to it.
+    void set_queue_capacity(std::size_t bytes)
+        requires(QueuePolicy::asynchronous)
+    {
         std::lock_guard lock(mutex_);
-        enable_output_to_console_ = enable;
+        queue_capacity_ = bytes;
     }
 
-    // Set the log level threshold for console output.
-    void set_level_threshold(LogLevel level) {
+    // Count the records of every call site in windows of the given length, and log the `top` call sites with the most
+    // records at the end of every window. The counting is done by the writer. Takes effect on the next initialization.
+    void set_heavy_hitters(std::chrono::system_clock::duration window, std::size_t top = 10) {
         std::lock_guard lock(mutex_);
-        level_threshold_ = level;
+        heavy_hitter_window_ = window;
+        heavy_hitter_top_ = top;
+    }
+
+    // The call sites with the most records in the last complete window. Empty unless set_heavy_hitters() was called.
+    HeavyHitterReport heavy_hitters() const {
+        return heavy_hitters_ ? heavy_hitters_->report() : HeavyHitterReport{};
+    }
+
+    // Estimated number of records of a call site in the current window. Zero unless set_heavy_hitters() was called.
+    // LOG_THROTTLED uses it to throttle a statement that floods the log.
+    std::uint64_t heavy_hitter_estimate(const CallSite& site) const {
+        return heavy_hitters_ ? heavy_hitters_->estimate(site) : 0;
+    }
+
+    // Set the log level threshold for console output.
+    void set_level_threshold(LogLevel level)
+        requires(has_sink<ConsoleSink>)
+    {
+        sink<ConsoleSink>().set_level_threshold(level);
     }
 
     // Shutdown the logger.
@@ -143,110 +1724,558 @@ public:
     }
 
     // Destructor.
-    ~Logger() {
+    ~basic_logger() {
 #if !defined(NDEBUG)
         std::cout << "Logger destructor" << std::endl;
+#endif
+#if MINILOG_HAS_SIGNAL_SAFE
+        signal_safe_instance_.store(nullptr, std::memory_order_release);
 #endif
         __shutdown();
     }
 
 private:
-    Logger() = default;
-    Logger(const Logger&) = delete;
-    Logger& operator=(const Logger&) = delete;
+    static constexpr LogLevel BACKTRACE_DISABLED = static_cast<LogLevel>(static_cast<int>(LogLevel::FATAL) + 1);
 
-    void __open_log_file() {
-        file_.open(file_name_, std::ios::app);
-        if (!file_.is_open()) {
-            throw std::runtime_error("Failed to open log file");
+    // Call site of the heavy hitter reports.
+    static inline constinit CallSite heavy_hitters_site_{LogLevel::INFO, "Heavy hitters",
+                                                         std::source_location::current()};
+
+    // Attempts to reserve a record before a real-time message is dropped.
+    static constexpr std::size_t REALTIME_RESERVE_ATTEMPTS = 16;
+
+    // Whether the queue policy is for real-time threads.
+    static constexpr bool realtime_queue = requires { requires QueuePolicy::realtime; };
+
+    // Whether every sink can be written by several threads at once.
+    static constexpr bool lock_free_sinks = (ThreadSafeSink<Sinks> && ...);
+
+    // Buffers of a thread writing messages.
+    struct WriterState {
+        std::string buffer; // Formatted message.
+        std::string line;   // Rendered line.
+        BacktraceSymbolizer symbolizer;
+    };
+
+    // Whether any sink is flushed after every synchronous record.
+    static constexpr bool flushes_records = (RecordFlushSink<Sinks> || ...);
+
+    // Whether any sink needs the rendered line.
+    static constexpr bool renders_line = (LineSink<Sinks> || ...);
+
+    // Whether any sink reads raw arguments, and whether any other sink needs them formatted.
+    static constexpr bool raw_argument_sinks = (RawArgumentSink<Sinks> || ...);
+    static constexpr bool formats_raw_arguments = (!RawArgumentSink<Sinks> || ...);
+
+    // Whether the arguments of a statement are stored raw: when a sink reads them and they are all arithmetic.
+    template<typename... Args>
+    static constexpr bool keeps_raw_arguments =
+        raw_argument_sinks && (std::is_arithmetic_v<std::remove_cvref_t<Args>> && ...);
+
+    // The destructor writes the queued messages, which needs the call site registry: construct it first, so that it
+    // is destroyed last.
+    basic_logger() {
+        CallSiteRegistry::instance();
+#if MINILOG_HAS_SIGNAL_SAFE
+        signal_safe_instance_.store(this, std::memory_order_release);
+#endif
+    }
+    basic_logger(const basic_logger&) = delete;
+    basic_logger& operator=(const basic_logger&) = delete;
+
+    template<typename Sink>
+    static void __open_sink(Sink& sink, const std::string& file_name) {
+        if constexpr (requires { sink.open(file_name); }) {
+            sink.open(file_name);
         }
-#if !defined(NDEBUG)
-        std::cout << "Log file: " << file_name_ << std::endl;
+    }
+
+    // Format a message into a record of the ring buffer, or into a heap-allocated message if the record would be too
+    // large. The message bytes are copied once; only oversized messages are allocated. The second pass is bounded by
+    // the size of the first one, which can differ if an argument is changed by another thread or a formatter depends
+    // on the time, and then the message is cut or shorter.
+    template<typename... Args>
+    void __enqueue_formatted(const CallSite& site, std::chrono::system_clock::time_point time,
+                             const RecordExtras& extras, std::format_string<Args...> fmt, Args&&... args) {
+        std::size_t extra = RecordHeader::extra_size(extras);
+        std::size_t length = std::formatted_size(fmt, std::forward<Args>(args)...);
+        std::size_t size = RingBuffer::record_size(extra + length);
+        if (size <= ring_.max_record_size()) {
+            RecordHeader* record = __reserve(size, extras);
+            auto* payload = reinterpret_cast<char*>(record->payload());
+            char* end;
+            try {
+                end = std::format_to_n(payload, length, fmt, std::forward<Args>(args)...).out;
+            } catch (...) {
+                // The reservation must still be published, or the backend would wait for it forever.
+                __commit(record, size, RecordKind::PADDING, site, 0, time);
+                throw;
+            }
+            __commit(record, size, RecordKind::FORMATTED, site, static_cast<std::size_t>(end - payload), time);
+        } else {
+            auto message = std::make_unique_for_overwrite<char[]>(length);
+            char* end = std::format_to_n(message.get(), length, fmt, std::forward<Args>(args)...).out;
+            auto written = static_cast<std::size_t>(end - message.get());
+            // Always fits: MIN_CAPACITY is chosen for this record.
+            size = RingBuffer::record_size(extra + sizeof(char*));
+            RecordHeader* record = __reserve(size, extras);
+            char* data = message.release(); // Deleted by the writer.
+            std::memcpy(record->payload(), &data, sizeof(char*));
+            __commit(record, size, RecordKind::HEAP, site, written, time);
+        }
+    }
+
+    // Reserve a record in the ring buffer and fill in its optional fields.
+    RecordHeader* __reserve(std::size_t size, const RecordExtras& extras) {
+        RecordHeader* record = __reserve(size);
+        __store_extras(record, extras);
+        return record;
+    }
+
+    // Copy the optional fields of a record between its header and its payload.
+    static void __store_extras(RecordHeader* record, const RecordExtras& extras) {
+        auto* data = reinterpret_cast<std::byte*>(record + 1);
+        record->flags = 0;
+        if (extras.trace != nullptr) {
+            record->flags |= RecordHeader::HAS_TRACE_CONTEXT;
+            std::memcpy(data, extras.trace, sizeof(TraceContext));
+            data += sizeof(TraceContext);
+        }
+        record->frames = static_cast<std::uint16_t>(extras.backtrace.size());
+        if (!extras.backtrace.empty()) {
+            std::memcpy(data, extras.backtrace.data(), extras.backtrace.size_bytes());
+        }
+    }
+
+    // Reserve a record in the ring buffer. If it is full, wait for the backend thread to free space or, with the
+    // manual backend, write the queued messages on the calling thread.
+    RecordHeader* __reserve(std::size_t size) {
+        RecordHeader* record;
+        while ((record = ring_.try_reserve(size)) == nullptr) {
+            if (backend_ == BackendMode::MANUAL) {
+                __pump(SIZE_MAX);
+                continue;
+            }
+            std::uint32_t seen = space_.load(std::memory_order_acquire);
+            waiting_producers_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((record = ring_.try_reserve(size)) == nullptr) {
+                space_.wait(seen, std::memory_order_acquire);
+            }
+            waiting_producers_.fetch_sub(1, std::memory_order_relaxed);
+            if (record != nullptr) {
+                break;
+            }
+        }
+        return record;
+    }
+
+    // Fill in the header of a reserved record and publish it to the backend.
+    void __commit(RecordHeader* record, std::size_t size, RecordKind kind, const CallSite& site, std::size_t length,
+                  std::chrono::system_clock::time_point time) {
+        __publish(record, size, kind, site, length, time);
+        if (!realtime_queue && backend_ == BackendMode::THREAD) {
+            // Pairs with the fence in __process_messages: either the backend sees the record or we see it sleeping.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed)) {
+                __ring_doorbell();
+            }
+        }
+    }
+
+    // Fill in the header of a record and commit it, without waking up the backend.
+    static void __publish(RecordHeader* record, std::size_t size, RecordKind kind, const CallSite& site,
+                          std::size_t length, std::chrono::system_clock::time_point time) {
+        record->kind = kind;
+        record->length = static_cast<std::uint32_t>(length);
+        record->site = &site;
+        record->time = time;
+#if MINILOG_HAS_USDT
+        std::string_view text = __probe_text(*record);
+        MINILOG_PROBE(enqueue, static_cast<int>(site.level), &site, text.data(), text.size());
+#endif
+        RingBuffer::commit(record, size);
+    }
+
+#if MINILOG_HAS_USDT
+    // Text of a record passed to the probes: the payload of a formatted message, the string of a message too long for
+    // the ring buffer, and the format string otherwise.
+    static std::string_view __probe_text(const RecordHeader& record) {
+        switch (record.kind) {
+        case RecordKind::FORMATTED: return {reinterpret_cast<const char*>(record.payload()), record.length};
+        case RecordKind::HEAP: {
+            const char* data;
+            std::memcpy(&data, record.payload(), sizeof(const char*));
+            return {data, record.length};
+        }
+        default: return record.site->format;
+        }
+    }
 #endif
+
+    void __ring_doorbell() {
+        doorbell_.fetch_add(1, std::memory_order_release);
+        doorbell_.notify_one();
     }
 
+    // Drain the ring buffer and park on the doorbell when it is empty. Producers only notify while it is parked.
     void __process_messages(std::stop_token st) {
         while (!st.stop_requested()) {
-            std::vector<LogMessage> messages;
-            {
-                std::unique_lock lock(mutex_);
-                cv_.wait(lock, [this, st] { return !messages_.empty() || st.stop_requested(); });
-                while (!messages_.empty()) {
-                    messages.emplace_back(std::move(messages_.front()));
-                    messages_.pop();
-                }
+            if (__drain() != 0) {
+                continue;
             }
-            for (const auto& message : messages) {
-                __write_log_message(message);
+            if constexpr (realtime_queue) {
+                // Real-time producers never ring the doorbell.
+                std::this_thread::sleep_for(QueuePolicy::poll_interval);
+                continue;
             }
+            std::uint32_t seen = doorbell_.load(std::memory_order_acquire);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ring_.readable() && !st.stop_requested()) {
+                doorbell_.wait(seen, std::memory_order_acquire);
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
         }
     }
 
-    void __write_log_message(const LogMessage& message) {
-        std::string level = __log_level_to_string(message.level);
-        auto now = std::chrono::zoned_time(std::chrono::current_zone(), message.time);
-        if (enable_output_to_console_ && message.level >= level_threshold_) {
-            std::cout << std::format("{:%Y/%m/%d %H:%M:%S} [{}] [{}:{}] {}\n", now, level, message.location.file_name(),
-                                     message.location.line(), message.message);
+    // Write up to `budget` committed records and wake up producers waiting for space.
+    std::size_t __drain(std::size_t budget = SIZE_MAX) {
+        std::size_t written = ring_.consume([this](RecordHeader& record) { __write_record(record); }, budget);
+        if (written != 0) {
+            std::apply([](auto&... sinks) { (__flush_sink(sinks), ...); }, sinks_);
+            MINILOG_PROBE(flush, written);
         }
-        file_ << std::format("{:%Y/%m/%d %H:%M:%S} [{}] [{}:{}] {}\n", now, level, message.location.file_name(),
-                             message.location.line(), message.message);
-        file_.flush();
-#if !defined(NDEBUG)
-        std::cout << "Message has been written to the log file" << std::endl;
+        flushed_bytes_.store(ring_.consumed_bytes(), std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (written != 0 && waiting_producers_.load(std::memory_order_relaxed) != 0) {
+            space_.fetch_add(1, std::memory_order_release);
+            space_.notify_all();
+        }
+        return written;
+    }
+
+    // Drain on an application thread. The ring buffer has a single consumer, so pumping threads take turns.
+    std::size_t __pump(std::size_t budget) {
+        std::lock_guard lock(pump_mutex_);
+        return __drain(budget);
+    }
+
+    void __write_record(RecordHeader& record) {
+        std::string_view message;
+        const char* data = nullptr;
+        switch (record.kind) {
+        case RecordKind::FORMATTED:
+            message = {reinterpret_cast<const char*>(record.payload()), record.length};
+            break;
+        case RecordKind::LITERAL:
+            message = record.site->format;
+            break;
+        case RecordKind::HEAP:
+            std::memcpy(&data, record.payload(), sizeof(const char*));
+            message = {data, record.length};
+            break;
+        case RecordKind::RAW: break;
+        default: return;
+        }
+        auto time = record.time;
+        if (record.flags & RecordHeader::TSC_TIME) {
+            time = tsc_.to_system_time(static_cast<std::uint64_t>(record.time.time_since_epoch().count()));
+        }
+#if MINILOG_HAS_USDT
+        std::string_view text = __probe_text(record);
+        MINILOG_PROBE(dequeue, static_cast<int>(record.site->level), record.site, text.data(), text.size());
 #endif
+        LogMessage log_message{record.site, message, record.kind == RecordKind::LITERAL, time, record.trace_context(),
+                               record.backtrace()};
+        if (record.kind == RecordKind::RAW) {
+            __write_raw(writer_, log_message, record.payload());
+        } else {
+            __write_log_message(writer_, log_message);
+        }
+        if (record.kind == RecordKind::HEAP) {
+            delete[] data;
+        }
+    }
+
+    static WriterState& __thread_writer() {
+        static thread_local WriterState writer;
+        return writer;
     }
 
-    std::string __log_level_to_string(LogLevel level) {
-        switch (level) {
-        case LogLevel::TRACE: return "TRACE";
-        case LogLevel::DEBUG: return "DEBUG";
-        case LogLevel::INFO: return "INFO";
-        case LogLevel::WARNING: return "WARNING";
-        case LogLevel::ERROR: return "ERROR";
-        case LogLevel::FATAL: return "FATAL";
-        default: return "UNKNOWN";
+    // Format and write a message on the calling thread.
+    template<typename... Args>
+    void __write_sync(WriterState& writer, const CallSite& site, std::chrono::system_clock::time_point time,
+                      const RecordExtras& extras, std::format_string<Args...> fmt, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            // Constant message: the literal has static storage duration, so no formatting is needed here.
+            __write_log_message(writer, {&site, site.format, true, time, extras.trace, extras.backtrace});
+        } else if constexpr (keeps_raw_arguments<Args...>) {
+            std::byte data[sizeof(const RawCodec*) + (sizeof(std::remove_cvref_t<Args>) + ...)];
+            __store_raw(data, args...);
+            __write_raw(writer, {&site, {}, false, time, extras.trace, extras.backtrace}, data);
+        } else {
+            writer.buffer.clear();
+            std::format_to(std::back_inserter(writer.buffer), fmt, std::forward<Args>(args)...);
+            __write_log_message(writer, {&site, writer.buffer, false, time, extras.trace, extras.backtrace});
         }
     }
 
-    void __shutdown() {
-        if (async_ && thread_.joinable()) {
-            thread_.request_stop();
-            cv_.notify_one();
-            thread_.join();
+    // Store a pointer to the codec of the arguments, followed by the arguments.
+    template<typename... Args>
+    static void __store_raw(std::byte* data, const Args&... args) {
+        const RawCodec* codec = &details::raw_codec<Args...>;
+        std::memcpy(data, &codec, sizeof(codec));
+        data += sizeof(codec);
+        ((std::memcpy(data, &args, sizeof(Args)), data += sizeof(Args)), ...);
+    }
+
+    // Write a message whose raw arguments are stored at `data` after their codec, formatting them if a sink needs it.
+    void __write_raw(WriterState& writer, LogMessage message, const std::byte* data) {
+        std::memcpy(&message.codec, data, sizeof(const RawCodec*));
+        message.args = data + sizeof(const RawCodec*);
+        if constexpr (formats_raw_arguments) {
+            writer.buffer.clear();
+            message.codec->format(writer.buffer, message.site->format, message.args);
+            message.message = writer.buffer;
+        }
+        __write_log_message(writer, message);
+    }
 
-            std::unique_lock lock(mutex_);
-            while (!messages_.empty()) {
-                __write_log_message(messages_.front());
-                messages_.pop();
+    // Render a line as timestamp + cached call site prefix + trace context + message and pass it to the sinks.
+    void __write_log_message(WriterState& writer, const LogMessage& message) {
+        std::string& line = writer.line;
+        std::string_view prefix = __call_site_prefix(*message.site); // Also assigns the id of the call site.
+        if constexpr (renders_line) {
+            line.clear();
+            std::format_to(std::back_inserter(line), "{:%Y/%m/%d %H:%M:%S} ",
+                           std::chrono::zoned_time(std::chrono::current_zone(), message.time));
+            line += prefix;
+            if (message.trace != nullptr) {
+                std::format_to(std::back_inserter(line), "[{:016x}{:016x}:{:016x}] ", message.trace->trace_id_high,
+                               message.trace->trace_id_low, message.trace->span_id);
             }
+            if (message.literal) {
+                details::append_literal(line, message.message);
+            } else {
+                line += message.message;
+            }
+            line += '\n';
+            writer.symbolizer.append(line, message.backtrace);
+        }
+        std::apply([&](auto&... sinks) { (__write_sink(sinks, message, line), ...); }, sinks_);
+        MINILOG_PROBE(write, static_cast<int>(message.site->level), message.site, line.data(), line.size());
+        // The reports are not counted, so that they do not show up in the next ones.
+        if (heavy_hitters_ && message.site != &heavy_hitters_site_ &&
+            heavy_hitters_->add(*message.site, message.time)) {
+            __write_heavy_hitters(writer, message.time);
+        }
+    }
+
+    // Log the heavy hitters of the window that has just ended, e.g.
+    // "Heavy hitters of the last 60s: 1200000 x server.cpp:42, 3100 x cache.cpp:17".
+    void __write_heavy_hitters(WriterState& writer, std::chrono::system_clock::time_point time) {
+        HeavyHitterReport report = heavy_hitters_->report();
+        writer.buffer.clear();
+        std::format_to(std::back_inserter(writer.buffer), "Heavy hitters of the last {}:",
+                       std::chrono::duration_cast<std::chrono::seconds>(report.window));
+        for (std::size_t i = 0; i < report.size; ++i) {
+            const HeavyHitter& hitter = report.sites[i];
+            std::format_to(std::back_inserter(writer.buffer), "{} {} x {}:{}", i == 0 ? "" : ",", hitter.count,
+                           hitter.site->location.file_name(), hitter.site->location.line());
+        }
+        __write_log_message(writer, {&heavy_hitters_site_, writer.buffer, false, time, nullptr, {}});
+    }
+
+    template<typename Sink>
+    static void __write_sink(Sink& sink, const LogMessage& message, std::string_view line) {
+        if constexpr (LineSink<Sink>) {
+            sink.write(message, line);
+        } else {
+            sink.write(message);
+        }
+    }
+
+    // Get the constant "[LEVEL] [file:line] " prefix of a call site, building and registering it on first use.
+    static std::string_view __call_site_prefix(const CallSite& site) {
+        std::call_once(site.once, [&] {
+            CallSiteRegistry::instance().add(site, std::format("[{}] [{}:{}] ", to_string(site.level),
+                                                               site.location.file_name(), site.location.line()));
+        });
+        return site.prefix;
+    }
+
+    void __shutdown() {
+        if constexpr (QueuePolicy::asynchronous) {
+            if (async_ && thread_.joinable()) {
+                thread_.request_stop();
+                __ring_doorbell();
+                thread_.join();
+                __drain();
+            } else if (backend_ == BackendMode::MANUAL) {
+                __pump(SIZE_MAX);
+            }
+        }
+        auto time = clock_.load(std::memory_order_relaxed)();
+        std::apply([time](auto&... sinks) { (__close_sink(sinks, time), ...); }, sinks_);
+#if MINILOG_HAS_SIGNAL_SAFE
+        if (int fd = signal_fd_.exchange(-1, std::memory_order_acq_rel); fd >= 0) {
+            ::close(fd);
         }
-        if (file_.is_open()) {
-            file_.close();
-#if !defined(NDEBUG)
-            std::cout << "Log file has been closed" << std::endl;
 #endif
+        initialized_.store(false, std::memory_order_release);
+    }
+
+    // Sinks that batch their output get flushed after every batch of records written by the backend.
+    template<typename Sink>
+    static void __flush_sink(Sink& sink) {
+        if constexpr (requires { sink.flush(); }) {
+            sink.flush();
         }
-        initialized_ = false;
     }
 
-    std::ofstream file_;
-    std::string file_name_;
+    // Sinks that ask for it get flushed after every record written synchronously.
+    template<typename Sink>
+    static void __flush_record(Sink& sink) {
+        if constexpr (RecordFlushSink<Sink>) {
+            sink.flush();
+        }
+    }
+
+    // Sinks that write something when closed, like a summary, get the time of the logger clock.
+    template<typename Sink>
+    static void __close_sink(Sink& sink, std::chrono::system_clock::time_point time) {
+        if constexpr (requires { sink.close(time); }) {
+            sink.close(time);
+        } else if constexpr (requires { sink.close(); }) {
+            sink.close();
+        }
+    }
+
+    std::tuple<Sinks...> sinks_;
+    std::atomic<LogLevel> level_ = LogLevel::TRACE;
+    std::atomic<LogLevel> backtrace_level_ = BACKTRACE_DISABLED;
+    std::atomic<ClockFunction> clock_ = &clocks::realtime;
+#if MINILOG_HAS_SIGNAL_SAFE
+    static inline constinit std::atomic<basic_logger*> signal_safe_instance_ = nullptr;
+    std::atomic<int> signal_fd_ = -1;          // Log file descriptor of log_signal_safe().
+    std::atomic<std::int64_t> utc_offset_ = 0; // Seconds added to the UTC time by log_signal_safe().
+#endif
     bool async_ = false;
-    bool initialized_ = false;
-    std::queue<LogMessage> messages_;
-    std::mutex mutex_;
-    std::condition_variable cv_;
+    BackendMode backend_ = BackendMode::NONE;
+    std::atomic<bool> initialized_ = false;
+    RingBuffer ring_;
+    std::atomic<std::uint64_t> flushed_bytes_ = 0; // Bytes of the ring buffer written and flushed by the backend.
+    std::size_t queue_capacity_ = 1 << 20; // Size of the ring buffer in bytes.
+    WriterState writer_;                   // Buffers of the backend, or of synchronous logging under the mutex.
+    TscCalibration tsc_;                   // Converts the times of real-time records.
+    std::atomic<std::uint64_t> dropped_ = 0; // Real-time messages dropped.
+    std::chrono::system_clock::duration heavy_hitter_window_{}; // Zero when heavy hitters are not counted.
+    std::size_t heavy_hitter_top_ = 10;
+    std::unique_ptr<HeavyHitters> heavy_hitters_;
+    mutex_type mutex_;
+    mutex_type pump_mutex_; // Serializes poll() and pumping by producers that found the ring buffer full.
+    std::atomic<std::uint32_t> doorbell_ = 0; // Bumped to wake up the parked backend thread.
+    std::atomic<bool> sleeping_ = false;       // Whether the backend thread is parked on the doorbell.
+    std::atomic<std::uint32_t> space_ = 0;    // Bumped when the backend frees space for waiting producers.
+    std::atomic<std::uint32_t> waiting_producers_ = 0;
     std::jthread thread_;
-    LogLevel level_threshold_ = LogLevel::INFO; // Default log level threshold for console output.
-    bool enable_output_to_console_ = true;
 };
 
-#define LOG_TRACE(...) Logger::instance().log(std::source_location::current(), LogLevel::TRACE, __VA_ARGS__)
-#define LOG_DEBUG(...) Logger::instance().log(std::source_location::current(), LogLevel::DEBUG, __VA_ARGS__)
-#define LOG_INFO(...) Logger::instance().log(std::source_location::current(), LogLevel::INFO, __VA_ARGS__)
-#define LOG_WARNING(...) Logger::instance().log(std::source_location::current(), LogLevel::WARNING, __VA_ARGS__)
-#define LOG_ERROR(...) Logger::instance().log(std::source_location::current(), LogLevel::ERROR, __VA_ARGS__)
-#define LOG_FATAL(...) Logger::instance().log(std::source_location::current(), LogLevel::FATAL, __VA_ARGS__)
+// The default logger: thread-safe, optionally asynchronous, writing to the console and a file.
+using Logger = basic_logger<MultiThreaded, RingQueue, ConsoleSink, FileSink>;
+
+// Logger accepting LOG_RT_* statements from real-time threads.
+using RealtimeLogger = basic_logger<MultiThreaded, RealtimeRingQueue, ConsoleSink, FileSink>;
+
+// Logger used by the LOG_* macros. Define it before including this header to log through another basic_logger.
+#if !defined(MINILOG_LOGGER)
+#define MINILOG_LOGGER ::minilog::Logger::instance()
+#endif
+
+// Log through a static call site of the given logger. The format string must be a literal.
+#define MINILOG_LOG_TO(logger, level, fmt, ...)                                                                        \
+    do {                                                                                                               \
+        static constinit ::minilog::CallSite __minilog_call_site{level, fmt, std::source_location::current()};         \
+        auto& __minilog_logger = (logger);                                                                             \
+        bool __minilog_enabled = __minilog_logger.should_log(level);                                                   \
+        MINILOG_PROBE(log, static_cast<int>(level), &__minilog_call_site, __minilog_call_site.format.data(),           \
+                      __minilog_enabled);                                                                              \
+        if (__minilog_enabled) {                                                                                       \
+            __minilog_logger.log(__minilog_call_site, fmt __VA_OPT__(, ) __VA_ARGS__);                                 \
+        }                                                                                                              \
+    } while (false)
+
+// Log through a static call site. The format string must be a literal.
+#define MINILOG_LOG(level, fmt, ...) MINILOG_LOG_TO(MINILOG_LOGGER, level, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+// Log through a static call site of the given logger while its heavy hitter estimate in the current window is below
+// `limit`, so that a statement that floods the log writes at most about `limit` records per window. Records still in
+// the queue are not counted yet. Logs every record unless set_heavy_hitters() was called.
+#define MINILOG_LOG_THROTTLED_TO(logger, level, limit, fmt, ...)                                                       \
+    do {                                                                                                               \
+        static constinit ::minilog::CallSite __minilog_call_site{level, fmt, std::source_location::current()};         \
+        auto& __minilog_logger = (logger);                                                                             \
+        bool __minilog_enabled = __minilog_logger.should_log(level) &&                                                 \
+                                 __minilog_logger.heavy_hitter_estimate(__minilog_call_site) < (limit);                \
+        MINILOG_PROBE(log, static_cast<int>(level), &__minilog_call_site, __minilog_call_site.format.data(),           \
+                      __minilog_enabled);                                                                              \
+        if (__minilog_enabled) {                                                                                       \
+            __minilog_logger.log(__minilog_call_site, fmt __VA_OPT__(, ) __VA_ARGS__);                                 \
+        }                                                                                                              \
+    } while (false)
+
+// Log through a static call site while its heavy hitter estimate is below `limit`. The level is a LogLevel, e.g.
+// LOG_THROTTLED(LogLevel::WARNING, 100, "Retrying {}", request).
+#define LOG_THROTTLED(level, limit, fmt, ...)                                                                          \
+    MINILOG_LOG_THROTTLED_TO(MINILOG_LOGGER, level, limit, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+// Log from a signal handler through a static call site. The message must be a literal with one replacement field per
+// argument; the arguments must be integers. Only the log level threshold is checked, not the override of the current
+// thread. The logger expression is not evaluated: the instance of its type is looked up without the initialization
+// guard of instance(), and messages are dropped if it has not been constructed yet.
+#define MINILOG_LOG_SIGNAL_SAFE_TO(logger, level, literal, ...)                                                        \
+    do {                                                                                                               \
+        static_assert(::minilog::details::replacement_field_count(literal) ==                                          \
+                          decltype(::minilog::details::argument_count(__VA_ARGS__))::value,                            \
+                      "The number of arguments does not match the replacement fields of the message");                 \
+        static constinit ::minilog::CallSite __minilog_call_site{level, literal, std::source_location::current()};     \
+        auto* __minilog_logger = std::remove_reference_t<decltype(logger)>::signal_safe_instance();                    \
+        if (__minilog_logger != nullptr && (level) >= __minilog_logger->log_level()) {                                 \
+            __minilog_logger->log_signal_safe(__minilog_call_site __VA_OPT__(, ) __VA_ARGS__);                         \
+        }                                                                                                              \
+    } while (false)
+
+// Log from a signal handler. The level is a LogLevel, e.g. LOG_SIGNAL_SAFE(LogLevel::WARNING, "Got signal {}", sig).
+#define LOG_SIGNAL_SAFE(level, literal, ...)                                                                           \
+    MINILOG_LOG_SIGNAL_SAFE_TO(MINILOG_LOGGER, level, literal __VA_OPT__(, ) __VA_ARGS__)
+
+// Log from a real-time thread through a static call site of the given logger. Requires a logger with a real-time
+// queue policy; the format string must be a literal and the arguments arithmetic.
+#define MINILOG_LOG_RT_TO(logger, level, fmt, ...)                                                                     \
+    do {                                                                                                               \
+        static constinit ::minilog::CallSite __minilog_call_site{level, fmt, std::source_location::current()};         \
+        auto& __minilog_logger = (logger);                                                                             \
+        if (__minilog_logger.should_log(level)) {                                                                      \
+            __minilog_logger.log_rt(__minilog_call_site, fmt __VA_OPT__(, ) __VA_ARGS__);                              \
+        }                                                                                                              \
+    } while (false)
+
+// Log from a real-time thread.
+#define MINILOG_LOG_RT(level, fmt, ...) MINILOG_LOG_RT_TO(MINILOG_LOGGER, level, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define LOG_RT_TRACE(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_RT_DEBUG(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_RT_INFO(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_RT_WARNING(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_RT_ERROR(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_RT_FATAL(fmt, ...) MINILOG_LOG_RT(::minilog::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+
+#define LOG_TRACE(fmt, ...) MINILOG_LOG(::minilog::LogLevel::TRACE, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) MINILOG_LOG(::minilog::LogLevel::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_INFO(fmt, ...) MINILOG_LOG(::minilog::LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_WARNING(fmt, ...) MINILOG_LOG(::minilog::LogLevel::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_ERROR(fmt, ...) MINILOG_LOG(::minilog::LogLevel::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_FATAL(fmt, ...) MINILOG_LOG(::minilog::LogLevel::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
 
 } // namespace minilog
\ No newline at end of file
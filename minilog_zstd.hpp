@@ -0,0 +1,255 @@
+#pragma once
+
+#include <minilog_v2.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Zstandard compression. Needs the zstd headers, and the program must be linked with libzstd.
+#if __has_include(<zstd.h>) && __has_include(<zdict.h>)
+#include <zdict.h>
+#include <zstd.h>
+#define MINILOG_HAS_ZSTD 1
+#else
+#define MINILOG_HAS_ZSTD 0
+#endif
+
+#if MINILOG_HAS_ZSTD
+namespace minilog {
+
+// Compressed text log files. Lines are compressed in small blocks, each an independent zstd frame, so that a block
+// can be written as soon as the backend has written a batch without waiting for more data. Small blocks compress
+// poorly on their own; a dictionary trained on the format strings of the call sites and the first lines of output
+// makes up for it. A file is a sequence of entries:
+//   tag (1 byte) | length of the payload (u32, little-endian) | payload
+// A DICTIONARY entry holds the format version and the dictionary the following blocks are compressed with, which is
+// empty until one has been trained. Every opening of the file starts with one. A BLOCK entry holds a zstd frame.
+namespace zstd {
+inline constexpr char DICTIONARY = 'D';
+inline constexpr char BLOCK = 'B';
+inline constexpr std::uint8_t VERSION = 1;
+inline constexpr std::size_t ENTRY_HEADER_SIZE = 5;
+
+namespace details {
+inline void append_entry(std::string& out, char tag, std::string_view payload) {
+    out.push_back(tag);
+    auto size = static_cast<std::uint32_t>(payload.size());
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(size >> (8 * i)));
+    }
+    out += payload;
+}
+} // namespace details
+
+// Decompress a file written by ZstdFileSink. A torn entry at the end is ignored; throws on damaged data.
+inline std::string decompress(std::string_view data) {
+    std::string out;
+    std::string_view dictionary;
+    ZSTD_DCtx* context = ZSTD_createDCtx();
+    if (context == nullptr) {
+        throw std::runtime_error("Failed to create a zstd context");
+    }
+    try {
+        while (data.size() >= ENTRY_HEADER_SIZE) {
+            std::uint32_t size = 0;
+            for (int i = 3; i >= 0; --i) {
+                size = size << 8 | static_cast<unsigned char>(data[1 + i]);
+            }
+            if (data.size() - ENTRY_HEADER_SIZE < size) {
+                break;
+            }
+            char tag = data[0];
+            std::string_view payload = data.substr(ENTRY_HEADER_SIZE, size);
+            data.remove_prefix(ENTRY_HEADER_SIZE + size);
+            if (tag == DICTIONARY) {
+                if (payload.empty() || static_cast<std::uint8_t>(payload[0]) > VERSION) {
+                    throw std::runtime_error("Unsupported compressed log version");
+                }
+                dictionary = payload.substr(1);
+                continue;
+            }
+            unsigned long long length = ZSTD_getFrameContentSize(payload.data(), payload.size());
+            if (tag != BLOCK || length == ZSTD_CONTENTSIZE_ERROR || length == ZSTD_CONTENTSIZE_UNKNOWN) {
+                throw std::runtime_error("Damaged compressed log block");
+            }
+            std::size_t offset = out.size();
+            out.resize(offset + length);
+            std::size_t written = ZSTD_decompress_usingDict(context, out.data() + offset, length, payload.data(),
+                                                            payload.size(), dictionary.data(), dictionary.size());
+            if (ZSTD_isError(written) || written != length) {
+                throw std::runtime_error("Damaged compressed log block");
+            }
+        }
+    } catch (...) {
+        ZSTD_freeDCtx(context);
+        throw;
+    }
+    ZSTD_freeDCtx(context);
+    return out;
+}
+} // namespace zstd
+
+// File sink compressing lines with zstd in small blocks (see namespace zstd). A block is written when it reaches the
+// block size, after every batch of the backend and when the sink is closed. Unless disabled, the sink trains a
+// dictionary once it has seen enough output, from the first lines and the prefixes and format strings of the call
+// sites registered so far, and compresses the following blocks with it. Lines written before that are compressed
+// without a dictionary, so nothing is held back while the sample is collected.
+class ZstdFileSink {
+public:
+    ZstdFileSink() = default;
+    ZstdFileSink(const ZstdFileSink&) = delete;
+    ZstdFileSink& operator=(const ZstdFileSink&) = delete;
+
+    ~ZstdFileSink() {
+        close();
+        ZSTD_freeCDict(dictionary_);
+        ZSTD_freeCCtx(context_);
+    }
+
+    // Set the compression level. Default is 3.
+    void set_level(int level) {
+        level_ = level;
+    }
+
+    // Set the size of the uncompressed blocks. Default is 4 KiB.
+    void set_block_size(std::size_t bytes) {
+        block_size_ = bytes;
+    }
+
+    // Set the bytes of output to sample and the size of the dictionary trained from them. Zero sample bytes disables
+    // the training. Default is 1 MiB of output for a 32 KiB dictionary.
+    void set_dictionary_training(std::size_t sample_bytes, std::size_t dictionary_size) {
+        sample_bytes_ = sample_bytes;
+        dictionary_size_ = dictionary_size;
+    }
+
+    // The trained dictionary, or an empty string if there is none yet.
+    std::string_view dictionary() const {
+        return dictionary_bytes_;
+    }
+
+    void open(const std::string& file_name) {
+        if (context_ == nullptr && (context_ = ZSTD_createCCtx()) == nullptr) {
+            throw std::runtime_error("Failed to create a zstd context");
+        }
+        fd_ = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open compressed log file");
+        }
+        // A dictionary trained before a reopening stays in use.
+        __append_dictionary();
+#if !defined(NDEBUG)
+        std::cout << "Compressed log file: " << file_name << std::endl;
+#endif
+    }
+
+    void write(const LogMessage&, std::string_view line) {
+        block_ += line;
+        if (dictionary_ == nullptr && sample_bytes_ != 0) {
+            sample_ += line;
+            sample_sizes_.push_back(line.size());
+            if (sample_.size() >= sample_bytes_) {
+                flush();
+                __train();
+            }
+        }
+        if (block_.size() >= block_size_) {
+            flush();
+        }
+    }
+
+    // Compress and write the pending lines.
+    void flush() {
+        if (block_.empty()) {
+            return;
+        }
+        compressed_.resize(ZSTD_compressBound(block_.size()));
+        std::size_t size =
+            dictionary_ != nullptr
+                ? ZSTD_compress_usingCDict(context_, compressed_.data(), compressed_.size(), block_.data(),
+                                           block_.size(), dictionary_)
+                : ZSTD_compressCCtx(context_, compressed_.data(), compressed_.size(), block_.data(), block_.size(),
+                                    level_);
+        block_.clear();
+        if (ZSTD_isError(size)) {
+            return; // The lines are lost, like the lines of a stream sink in a failed state.
+        }
+        entry_.clear();
+        zstd::details::append_entry(entry_, zstd::BLOCK, std::string_view(compressed_.data(), size));
+        minilog::details::write_all(fd_, entry_);
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            flush();
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    // Train a dictionary on the sampled lines and the call sites, and start using it. On failure, blocks stay
+    // compressed without a dictionary.
+    void __train() {
+        for (const CallSite* site : CallSiteRegistry::instance().sites()) {
+            std::size_t size = sample_.size();
+            sample_ += site->prefix;
+            sample_ += site->format;
+            sample_sizes_.push_back(sample_.size() - size);
+        }
+        std::string dictionary(dictionary_size_, '\0');
+        std::size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), sample_.data(),
+                                                 sample_sizes_.data(), static_cast<unsigned>(sample_sizes_.size()));
+        sample_bytes_ = 0; // Train only once.
+        std::string().swap(sample_);
+        std::vector<std::size_t>().swap(sample_sizes_);
+        if (ZDICT_isError(size)) {
+#if !defined(NDEBUG)
+            std::cout << "Failed to train a zstd dictionary: " << ZDICT_getErrorName(size) << std::endl;
+#endif
+            return;
+        }
+        dictionary.resize(size);
+        dictionary_ = ZSTD_createCDict(dictionary.data(), dictionary.size(), level_);
+        if (dictionary_ == nullptr) {
+            return;
+        }
+        dictionary_bytes_ = std::move(dictionary);
+        __append_dictionary();
+#if !defined(NDEBUG)
+        std::cout << "Trained a zstd dictionary of " << dictionary_bytes_.size() << " bytes" << std::endl;
+#endif
+    }
+
+    void __append_dictionary() {
+        entry_.clear();
+        std::string payload(1, static_cast<char>(zstd::VERSION));
+        payload += dictionary_bytes_;
+        zstd::details::append_entry(entry_, zstd::DICTIONARY, payload);
+        minilog::details::write_all(fd_, entry_);
+    }
+
+    int fd_ = -1;
+    int level_ = 3;
+    std::size_t block_size_ = 4 * 1024;
+    std::size_t sample_bytes_ = 1024 * 1024;
+    std::size_t dictionary_size_ = 32 * 1024;
+    ZSTD_CCtx* context_ = nullptr;
+    ZSTD_CDict* dictionary_ = nullptr;
+    std::string dictionary_bytes_;
+    std::string sample_;                    // Lines collected for the training.
+    std::vector<std::size_t> sample_sizes_; // Size of each of them.
+    std::string block_;                     // Lines not compressed yet.
+    std::string compressed_;
+    std::string entry_;
+};
+
+} // namespace minilog
+#endif
@@ -0,0 +1,94 @@
+// Checks that log statements do not allocate on the logging thread once warmed up, in synchronous and asynchronous
+// mode, and that the backend allocates at a bounded rate. Global operator new is replaced to count allocations per
+// thread.
+#include <minilog_v2.hpp>
+
+#include <cstdio>
+#include <new>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, RingQueue, FileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+std::atomic<std::uint64_t> total_allocations = 0;
+thread_local std::uint64_t thread_allocations = 0;
+
+// Allocations per message allowed on the backend thread in steady state.
+constexpr double MAX_BACKEND_ALLOCATIONS_PER_MESSAGE = 0.01;
+
+constexpr int MESSAGES = 10000;
+} // namespace
+
+void* operator new(std::size_t size) {
+    ++thread_allocations;
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+// Log the same statements as the measured run, at enabled and disabled levels.
+void log_messages(int count) {
+    for (int i = 0; i < count; ++i) {
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Order {} filled at {:.2f}", i, i * 0.25);
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::WARNING, "Constant message");
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::ERROR, "Status {} from {}", i % 3 == 0, "gateway");
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::DEBUG, "Dropped by the level threshold {}", i);
+    }
+}
+
+// Run the statements on a producer thread after a warm-up and check its allocations. Returns false on failure.
+bool check_producer(const char* mode) {
+    std::uint64_t allocations = 0;
+    std::uint64_t total_before = 0;
+    std::thread producer([&] {
+        log_messages(16); // Grow the buffers and register the call sites.
+        TestLogger::instance().flush(); // Let the backend write them.
+        total_before = total_allocations.load();
+        std::uint64_t before = thread_allocations;
+        log_messages(MESSAGES);
+        allocations = thread_allocations - before;
+    });
+    producer.join();
+    TestLogger::instance().shutdown();
+    std::uint64_t others = total_allocations.load() - total_before - allocations;
+    std::printf("%s: %llu allocations on the producer, %llu on other threads for %d messages\n", mode,
+                static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(others), MESSAGES * 3);
+    if (allocations != 0) {
+        std::printf("FAILED: %s log statements allocate\n", mode);
+        return false;
+    }
+    if (others > MAX_BACKEND_ALLOCATIONS_PER_MESSAGE * MESSAGES * 3) {
+        std::printf("FAILED: the %s backend allocates too often\n", mode);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int main() {
+    auto& logger = TestLogger::instance();
+    logger.set_log_level(LogLevel::INFO);
+
+    std::remove("test_alloc.log");
+    logger.initialize("test_alloc.log", LogLevel::INFO, false);
+    bool ok = check_producer("synchronous");
+
+    logger.initialize("test_alloc.log", LogLevel::INFO, true);
+    ok = check_producer("asynchronous") && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// Checks that records written by BinaryFileSink decode to the same call sites, times and arguments: varint and zigzag
+// boundaries, float and double bit patterns, times going backwards and before 1970, call sites described in the middle
+// of the stream, and records of several call sites interleaved.
+#include <minilog_binary.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<SingleThreaded, SyncQueue, BinaryFileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+constexpr const char* FILE_NAME = "test_binary.log";
+
+// A record as logged.
+struct Expected {
+    std::string_view format;
+    std::chrono::sys_time<std::chrono::nanoseconds> time;
+    std::vector<binary::Argument> arguments;
+    std::optional<std::string> text;
+};
+
+// Times of the records in order: forward, backward, far forward, before the epoch and back.
+const std::vector<std::chrono::nanoseconds> TIMES = [] {
+    using namespace std::chrono;
+    const nanoseconds start = sys_days(year(2025) / 1 / 1).time_since_epoch();
+    return std::vector<nanoseconds>{start + 1ns, start, start + 1000ns, start - 1s, start + 9000h, start, -1ns,
+                                    -nanoseconds(days(365)), start + 1s + 1ns, nanoseconds(0), start - 1ns,
+                                    start + 42ns};
+}();
+
+template<typename T>
+binary::Argument argument(T value) {
+    if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, char> || std::is_floating_point_v<T>) {
+        return value;
+    } else if constexpr (std::is_signed_v<T>) {
+        return static_cast<std::int64_t>(value);
+    } else {
+        return static_cast<std::uint64_t>(value);
+    }
+}
+
+// The arguments as decoded if they are kept raw, that is if they are all arithmetic.
+template<typename... Args>
+std::vector<binary::Argument> arguments(const Args&... args) {
+    if constexpr ((std::is_arithmetic_v<Args> && ...)) {
+        return {argument(args)...};
+    } else {
+        return {};
+    }
+}
+
+// Log a record at the next time and remember what was logged.
+#define MINILOG_TEST_LOG(expected, fmt, ...)                                                                           \
+    do {                                                                                                               \
+        auto __time = std::chrono::sys_time<std::chrono::nanoseconds>(TIMES[expected.size() % TIMES.size()]);          \
+        ManualClock::set(std::chrono::time_point_cast<std::chrono::system_clock::duration>(__time));                   \
+        expected.push_back({fmt, __time, arguments(__VA_ARGS__), {}});                                                 \
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, fmt __VA_OPT__(, ) __VA_ARGS__);                           \
+    } while (false)
+
+// Log the records of a round. Call sites are added in later rounds, so they are described in the middle of the stream,
+// and the order of the call sites changes from round to round.
+void log_round(int round, std::vector<Expected>& expected) {
+    using Limits64 = std::numeric_limits<std::int64_t>;
+    for (int turn = 0; turn < 6; ++turn) {
+        switch ((turn + round) % 6) {
+        case 0:
+            MINILOG_TEST_LOG(expected, "Zero {}", std::int64_t(0));
+            MINILOG_TEST_LOG(expected, "One {}", std::int64_t(1));
+            MINILOG_TEST_LOG(expected, "Minus one {}", std::int64_t(-1));
+            MINILOG_TEST_LOG(expected, "Min {}", Limits64::min());
+            MINILOG_TEST_LOG(expected, "Max {}", Limits64::max());
+            break;
+        case 1:
+            MINILOG_TEST_LOG(expected, "Unsigned {}", std::uint64_t(127));
+            MINILOG_TEST_LOG(expected, "Unsigned {}", std::uint64_t(128));
+            MINILOG_TEST_LOG(expected, "Unsigned {}", std::numeric_limits<std::uint64_t>::max());
+            MINILOG_TEST_LOG(expected, "Narrow {}", std::int8_t(-128));
+            MINILOG_TEST_LOG(expected, "Narrow {}", std::numeric_limits<std::int32_t>::min());
+            MINILOG_TEST_LOG(expected, "Narrow unsigned {}", std::uint16_t(65535));
+            break;
+        case 2:
+            MINILOG_TEST_LOG(expected, "Float {}", -0.0f);
+            MINILOG_TEST_LOG(expected, "Float {}", std::numeric_limits<float>::infinity());
+            MINILOG_TEST_LOG(expected, "Float {}", std::bit_cast<float>(0x7fc01234u)); // NaN with a payload.
+            MINILOG_TEST_LOG(expected, "Float {}", std::numeric_limits<float>::denorm_min());
+            MINILOG_TEST_LOG(expected, "Float {}", std::numeric_limits<float>::max());
+            break;
+        case 3:
+            MINILOG_TEST_LOG(expected, "Double {}", -0.0);
+            MINILOG_TEST_LOG(expected, "Double {}", -std::numeric_limits<double>::infinity());
+            MINILOG_TEST_LOG(expected, "Double {}", std::bit_cast<double>(0xfff8000000000001ull));
+            MINILOG_TEST_LOG(expected, "Double {}", std::numeric_limits<double>::denorm_min());
+            MINILOG_TEST_LOG(expected, "Double {}", std::numeric_limits<double>::lowest());
+            break;
+        case 4:
+            if (round > 0) {
+                MINILOG_TEST_LOG(expected, "Flag {}", true);
+                MINILOG_TEST_LOG(expected, "Char {}", 'x');
+            }
+            break;
+        default:
+            if (round > 1) {
+                MINILOG_TEST_LOG(expected, "Literal");
+                MINILOG_TEST_LOG(expected, "Text {}", std::string("not arithmetic"));
+                expected.back().text = "Text not arithmetic";
+            }
+        }
+    }
+}
+
+// Arguments are compared bit for bit, so that NaNs and the sign of zero count.
+bool same(const binary::Argument& a, const binary::Argument& b) {
+    if (a.index() != b.index()) {
+        return false;
+    }
+    if (auto* value = std::get_if<float>(&a)) {
+        return std::bit_cast<std::uint32_t>(*value) == std::bit_cast<std::uint32_t>(std::get<float>(b));
+    }
+    if (auto* value = std::get_if<double>(&a)) {
+        return std::bit_cast<std::uint64_t>(*value) == std::bit_cast<std::uint64_t>(std::get<double>(b));
+    }
+    return a == b;
+}
+
+std::string read_file() {
+    std::ifstream file(FILE_NAME, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+} // namespace
+
+int main() {
+    std::remove(FILE_NAME);
+    auto& logger = TestLogger::instance();
+    logger.initialize(FILE_NAME, LogLevel::INFO, false);
+    logger.set_clock(&ManualClock::now);
+    std::vector<Expected> expected;
+    for (int round = 0; round < 4; ++round) {
+        log_round(round, expected);
+    }
+    logger.shutdown();
+
+    std::string content = read_file();
+    std::string_view data = content;
+    binary::Decoder decoder;
+    binary::DecodedRecord record;
+    std::size_t count = 0;
+    bool ok = true;
+    try {
+        for (; decoder.next(data, record) && count < expected.size(); ++count) {
+            const Expected& logged = expected[count];
+            const binary::SiteDescription* site = decoder.site(record.site);
+            bool arguments = record.arguments.size() == logged.arguments.size();
+            for (std::size_t i = 0; arguments && i < logged.arguments.size(); ++i) {
+                arguments = same(record.arguments[i], logged.arguments[i]);
+            }
+            bool text = logged.text ? decoder.message(record) == *logged.text : !record.text.has_value();
+            if (site == nullptr || site->format != logged.format || record.time != logged.time || !arguments ||
+                !text) {
+                std::printf("FAILED: record %zu (%.*s) does not decode as logged\n", count,
+                            static_cast<int>(logged.format.size()), logged.format.data());
+                ok = false;
+            }
+        }
+    } catch (const std::runtime_error& error) {
+        std::printf("FAILED: %s\n", error.what());
+        return 1;
+    }
+    if (count != expected.size() || !data.empty()) {
+        std::printf("FAILED: %zu records decoded out of %zu\n", count, expected.size());
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// Checks that binary::Decoder renders the records written by BinaryFileSink as FileSink writes them: raw arguments
+// with format specifications, text and literal messages, trace contexts, fractional seconds, and the local time on
+// both sides of the daylight saving time changes of Europe/Berlin.
+#include <minilog_binary.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace minilog;
+
+// Both loggers log the same statements with the same manual clock.
+using BinaryLogger = basic_logger<MultiThreaded, SyncQueue, BinaryFileSink>;
+using TextLogger = basic_logger<SingleThreaded, SyncQueue, FileSink>;
+
+namespace {
+template<typename Logger>
+void log_records(Logger& logger, int i) {
+    MINILOG_LOG_TO(logger, LogLevel::INFO, "Order {} filled at {:.2f} for account {:#x}", i, i * 0.25, i % 7);
+    MINILOG_LOG_TO(logger, LogLevel::WARNING, "Gateway {} says {}", i % 3, std::string(i % 5, 'z'));
+    MINILOG_LOG_TO(logger, LogLevel::ERROR, "Literal with {{braces}}");
+    {
+        scoped_trace_context trace({0x0af7651916cd43dd, 0x8448eb211c80319c + i, 0xb7ad6b7169203331});
+        MINILOG_LOG_TO(logger, LogLevel::INFO, "Traced {} {} {:>4}", i % 2 == 0, 'c', -i);
+    }
+}
+
+std::string read_file(const char* name) {
+    std::ifstream file(name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+} // namespace
+
+int main() {
+    // A zone with daylight saving time, set before anything reads the local time zone.
+    ::setenv("TZ", "Europe/Berlin", 1);
+    ::tzset();
+    std::remove("test_decoder.bin");
+    std::remove("test_decoder.log");
+    auto& binary_logger = BinaryLogger::instance();
+    auto& text_logger = TextLogger::instance();
+    binary_logger.initialize("test_decoder.bin", LogLevel::INFO, false);
+    text_logger.initialize("test_decoder.log", LogLevel::INFO, false);
+    binary_logger.set_clock(&ManualClock::now);
+    text_logger.set_clock(&ManualClock::now);
+
+    using namespace std::chrono;
+    int i = 0;
+    // The changes to and from summer time, at 01:00 UTC.
+    for (sys_days day : {sys_days(year(2025) / 3 / 30), sys_days(year(2025) / 10 / 26)}) {
+        for (sys_time<minutes> time = day - 1h; time < day + 3h; time += 20min) {
+            ManualClock::set(time + 123456789ns);
+            log_records(binary_logger, i);
+            log_records(text_logger, i);
+            ++i;
+        }
+    }
+    binary_logger.shutdown();
+    text_logger.shutdown();
+
+    std::istringstream text(read_file("test_decoder.log"));
+    std::string content = read_file("test_decoder.bin");
+    std::string_view data = content;
+    binary::Decoder decoder;
+    binary::DecodedRecord record;
+    std::size_t records = 0;
+    bool summer_time = false;
+    for (std::string line; std::getline(text, line); ++records) {
+        summer_time |= line.starts_with("2025/03/30 03:");
+        if (!decoder.next(data, record)) {
+            std::printf("FAILED: the binary file ends after %zu records\n", records);
+            return 1;
+        }
+        if (std::string decoded = decoder.line(record); decoded != line) {
+            std::printf("FAILED: decoded\n  %s\ninstead of\n  %s\n", decoded.c_str(), line.c_str());
+            return 1;
+        }
+    }
+    if (records == 0 || decoder.next(data, record)) {
+        std::printf("FAILED: the binary file does not have the records of the text file\n");
+        return 1;
+    }
+    if (!summer_time) {
+        std::printf("Europe/Berlin is not available: the daylight saving time changes were not checked\n");
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Checks that FramedFileSink cuts a torn write off the end of a file when it opens it again and keeps the valid frames,
+// also after the longest frame, and that it refuses a file that is not framed without changing it.
+#include <minilog_framing.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<SingleThreaded, SyncQueue, FramedFileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+constexpr const char* FILE_NAME = "test_framing.log";
+
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+std::string read_file() {
+    std::ifstream file(FILE_NAME, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+void write_file(std::string_view content) {
+    std::ofstream file(FILE_NAME, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// Payloads of the frames of the file, or nothing if one is damaged.
+std::vector<std::string> read_frames() {
+    std::string content = read_file();
+    std::span<const std::byte> data(reinterpret_cast<const std::byte*>(content.data()), content.size());
+    std::vector<std::string> frames;
+    std::size_t offset = 0;
+    while (true) {
+        std::string_view payload;
+        std::size_t next;
+        framing::FrameStatus status = framing::parse(data, offset, payload, next);
+        if (status == framing::FrameStatus::END) {
+            return frames;
+        }
+        if (status == framing::FrameStatus::INVALID) {
+            return {};
+        }
+        if (status == framing::FrameStatus::FRAME) {
+            frames.emplace_back(payload);
+        }
+        offset = next;
+    }
+}
+
+// Open the file with the logger, log the given line and close it. Returns the bytes cut off the file.
+std::uint64_t append(const std::string& line) {
+    auto& logger = TestLogger::instance();
+    logger.initialize(FILE_NAME, LogLevel::INFO, false);
+    std::uint64_t truncated = logger.sink<FramedFileSink>().truncated_bytes();
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "{}", line);
+    logger.shutdown();
+    return truncated;
+}
+
+#if defined(__linux__)
+std::size_t open_descriptors() {
+    return static_cast<std::size_t>(std::distance(std::filesystem::directory_iterator("/proc/self/fd"), {}));
+}
+#endif
+} // namespace
+
+int main() {
+    bool ok = true;
+    std::filesystem::remove(FILE_NAME);
+    append("first");
+    append("second");
+    std::string valid = read_file();
+    // A frame torn by a crash: its header and part of its payload.
+    std::string torn;
+    framing::append_frame(torn, "lost line\n");
+    write_file(valid + torn.substr(0, torn.size() - 4));
+    if (append("third") != torn.size() - 4) {
+        ok = fail("the torn frame is not cut off");
+    }
+    std::vector<std::string> frames = read_frames();
+    if (frames.size() != 3 || !frames[0].ends_with("] first\n") || !frames[1].ends_with("] second\n") ||
+        !frames[2].ends_with("] third\n")) {
+        ok = fail("the valid frames are not kept");
+    }
+
+    // The longest frame, and a torn one as long after it in the next block.
+    std::filesystem::remove(FILE_NAME);
+    append(std::string(framing::MAX_PAYLOAD + 100, 'x'));
+    append(std::string(framing::MAX_PAYLOAD, 'y'));
+    std::string content = read_file();
+    write_file(std::string_view(content).substr(0, content.size() - 10));
+    try {
+        append("after the longest frames");
+        frames = read_frames();
+        if (frames.size() != 2 || frames[0].size() != framing::MAX_PAYLOAD ||
+            !frames[1].ends_with("] after the longest frames\n")) {
+            ok = fail("a long frame is not cut, or the frame before a long torn frame is lost");
+        }
+    } catch (const std::runtime_error&) {
+        ok = fail("the file cannot be opened after a long torn frame");
+    }
+
+    const std::string text = "2025/01/01 00:00:00.000000000 [INFO] [main.cpp:1] Plain text\n";
+    write_file(text);
+#if defined(__linux__)
+    std::size_t descriptors = open_descriptors();
+#endif
+    try {
+        append("not framed");
+        ok = fail("a plain text file is accepted");
+    } catch (const std::runtime_error&) {
+    }
+    if (read_file() != text) {
+        ok = fail("a plain text file is changed");
+    }
+#if defined(__linux__)
+    if (open_descriptors() != descriptors) {
+        ok = fail("the descriptor of a refused file is leaked");
+    }
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Checks the heavy hitters of a logger with a manual clock: the counts and the order of two call sites in the report
+// of a complete window, that the report line is not counted itself, that a call site that has not logged has no
+// estimate, and that LOG_THROTTLED stops logging once its call site reaches the limit in a window.
+#include <minilog_v2.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, SyncQueue, FileSink>;
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+constinit CallSite frequent_site{LogLevel::INFO, "Frequent {}", std::source_location::current()};
+constinit CallSite rare_site{LogLevel::WARNING, "Rare {}", std::source_location::current()};
+constinit CallSite silent_site{LogLevel::ERROR, "Silent", std::source_location::current()};
+
+constexpr std::uint64_t FREQUENT = 300;
+constexpr std::uint64_t RARE = 40;
+constexpr std::uint64_t LIMIT = 25;
+
+bool check(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+    }
+    return condition;
+}
+} // namespace
+
+int main() {
+    auto& logger = TestLogger::instance();
+    std::remove("test_heavy_hitters.log");
+    logger.set_heavy_hitters(std::chrono::seconds(60), 5);
+    logger.initialize("test_heavy_hitters.log", LogLevel::INFO, false);
+    logger.set_clock(&ManualClock::now);
+
+    // Three windows. The report of the first one is logged in the second one, and the second one is reported when
+    // the third one starts.
+    ManualClock::set(std::chrono::sys_days(std::chrono::year(2025) / 1 / 1));
+    for (int window = 0; window < 3; ++window) {
+        for (std::uint64_t i = 0; i < FREQUENT; ++i) {
+            logger.log(frequent_site, "Frequent {}", i);
+            if (i < RARE) {
+                logger.log(rare_site, "Rare {}", i);
+            }
+            MINILOG_LOG_THROTTLED_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, LIMIT, "Throttled {}", i);
+            ManualClock::advance(std::chrono::milliseconds(100));
+        }
+        ManualClock::advance(std::chrono::seconds(60));
+    }
+    HeavyHitterReport report = logger.heavy_hitters();
+    bool ok = check(report.size == 3, "the report does not have exactly the three call sites that logged");
+    ok = ok && check(report.sites[0].site == &frequent_site && report.sites[1].site == &rare_site,
+                     "the call sites are not in order of their counts");
+    ok = ok && check(report.sites[0].count == FREQUENT && report.sites[1].count == RARE &&
+                         report.sites[2].count == LIMIT,
+                     "the counts differ from the numbers of records");
+    ok = ok && check(report.window == std::chrono::seconds(60), "the window of the report is wrong");
+    ok = check(logger.heavy_hitter_estimate(frequent_site) == FREQUENT, "wrong estimate in the current window") && ok;
+    ok = check(logger.heavy_hitter_estimate(silent_site) == 0, "a call site that has not logged has an estimate") && ok;
+    logger.shutdown();
+
+    // The throttled statement wrote LIMIT records in each window.
+    std::ifstream file("test_heavy_hitters.log");
+    std::uint64_t throttled = 0;
+    for (std::string line; std::getline(file, line);) {
+        throttled += line.find("] Throttled ") != std::string::npos;
+    }
+    ok = check(throttled == 3 * LIMIT, "the throttled statement did not write the limit in every window") && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Checks that minilog_merge orders the records of files written by FileSink by their sub-second timestamps, and
+// records with equal timestamps by input and then by position. The path of minilog_merge is the first argument.
+#include <minilog_reader.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace minilog;
+
+// Two loggers writing to their own files, with the same manual clock.
+using FirstLogger = basic_logger<MultiThreaded, SyncQueue, FileSink>;
+using SecondLogger = basic_logger<SingleThreaded, SyncQueue, FileSink>;
+
+namespace {
+void at(std::chrono::microseconds time) {
+    ManualClock::set(std::chrono::sys_days(std::chrono::year(2025) / 1 / 1) + time);
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::printf("Usage: test_merge <path of minilog_merge>\n");
+        return 2;
+    }
+    auto& first = FirstLogger::instance();
+    auto& second = SecondLogger::instance();
+    for (const char* name : {"test_merge.0.log", "test_merge.1.log", "test_merge.log"}) {
+        std::remove(name);
+    }
+    first.initialize("test_merge.0.log", LogLevel::INFO, false);
+    second.initialize("test_merge.1.log", LogLevel::INFO, false);
+    first.set_clock(&ManualClock::now);
+    second.set_clock(&ManualClock::now);
+
+    // Within one second; "a2" and "b1" have the same time, "b1" and "b2" too.
+    at(std::chrono::microseconds(0));
+    MINILOG_LOG_TO(first, LogLevel::INFO, "a0");
+    at(std::chrono::microseconds(1000));
+    MINILOG_LOG_TO(first, LogLevel::INFO, "a1");
+    at(std::chrono::microseconds(1500));
+    MINILOG_LOG_TO(second, LogLevel::INFO, "b0");
+    at(std::chrono::microseconds(2000));
+    MINILOG_LOG_TO(second, LogLevel::INFO, "b1");
+    MINILOG_LOG_TO(second, LogLevel::INFO, "b2");
+    MINILOG_LOG_TO(first, LogLevel::INFO, "a2");
+    at(std::chrono::microseconds(3000));
+    MINILOG_LOG_TO(first, LogLevel::INFO, "a3");
+    first.shutdown();
+    second.shutdown();
+
+    std::string command = std::string(argv[1]) + " -o test_merge.log test_merge.0.log test_merge.1.log";
+    if (std::system(command.c_str()) != 0) {
+        std::printf("FAILED: %s\n", command.c_str());
+        return 1;
+    }
+    std::vector<std::string_view> expected = {"a0", "a1", "b0", "a2", "b1", "b2", "a3"};
+    std::vector<std::string_view> merged;
+    Reader reader("test_merge.log");
+    for (const RecordView& record : reader) {
+        merged.push_back(record.message);
+    }
+    if (merged != expected) {
+        std::printf("FAILED: merged records are out of order:");
+        for (std::string_view message : merged) {
+            std::printf(" %.*s", static_cast<int>(message.size()), message.data());
+        }
+        std::printf("\n");
+        return 1;
+    }
+    return 0;
+}
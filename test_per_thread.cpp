@@ -0,0 +1,114 @@
+// Checks that PerThreadFileSink writes the lines of every thread to the file of that thread, creates no file for a
+// thread that does not log, closes the files of live threads when the logger shuts down, and refuses a backend.
+#include <minilog_v2.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, RingQueue, PerThreadFileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+// Per-thread files of test_per_thread.log in the current directory, by name, with their content.
+std::map<std::string, std::string> thread_files() {
+    std::map<std::string, std::string> files;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        std::string name = entry.path().filename().string();
+        if (name.starts_with("test_per_thread.") && name.ends_with(".log")) {
+            std::ifstream file(entry.path());
+            files[name].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    }
+    return files;
+}
+
+#if defined(__linux__)
+// Number of descriptors of the process open on a per-thread file.
+std::size_t open_thread_files() {
+    std::size_t count = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd", error)) {
+        std::string target = std::filesystem::read_symlink(entry.path(), error).filename().string();
+        count += target.starts_with("test_per_thread.") && target.ends_with(".log");
+    }
+    return count;
+}
+#endif
+} // namespace
+
+int main() {
+    for (const auto& [name, content] : thread_files()) {
+        std::filesystem::remove(name);
+    }
+    auto& logger = TestLogger::instance();
+    bool ok = true;
+    try {
+        logger.initialize("test_per_thread.log", LogLevel::INFO, true);
+        ok = fail("a backend is accepted");
+        logger.shutdown();
+    } catch (const std::runtime_error&) {
+    }
+    logger.initialize("test_per_thread.log", LogLevel::INFO, false);
+    if (!thread_files().empty()) {
+        ok = fail("initialize() leaves a file behind");
+    }
+
+    std::thread worker([] {
+        for (int i = 0; i < 10; ++i) {
+            MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Worker {}", i);
+        }
+    });
+    worker.join();
+    // A pool thread that is still alive when the logger shuts down.
+    std::atomic<int> step = 0;
+    std::thread pool([&] {
+        for (int i = 0; i < 10; ++i) {
+            MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Pool {}", i);
+        }
+        step = 1;
+        step.notify_all();
+        step.wait(1);
+    });
+    step.wait(0);
+#if defined(__linux__)
+    if (open_thread_files() != 1) {
+        ok = fail("the file of the pool thread is not open");
+    }
+#endif
+    logger.shutdown();
+#if defined(__linux__)
+    if (open_thread_files() != 0) {
+        ok = fail("the file of a live thread stays open after shutdown");
+    }
+#endif
+    step = 2;
+    step.notify_all();
+    pool.join();
+
+    std::map<std::string, std::string> files = thread_files();
+    if (files.size() != 2) {
+        ok = fail("wrong number of files");
+    }
+    std::size_t worker_files = 0;
+    std::size_t pool_files = 0;
+    for (const auto& [name, content] : files) {
+        bool worker_lines = content.find("Worker 9\n") != std::string::npos;
+        bool pool_lines = content.find("Pool 9\n") != std::string::npos;
+        worker_files += worker_lines && !pool_lines;
+        pool_files += pool_lines && !worker_lines;
+    }
+    if (worker_files != 1 || pool_files != 1) {
+        ok = fail("the lines of the threads are not in their own files");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// Checks that the ring buffer of an asynchronous logger stays consistent when a message is formatted differently by
+// the two passes of log(), which measure the message and then write it into the reserved record, or when the second
+// pass throws, and that the smallest ring buffer takes every record, with the backend thread and the manual backend.
+#include <minilog_v2.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, RingQueue, FileSink>;
+
+namespace {
+// Sink keeping the arithmetic arguments of the records raw, which counts the records that kept them.
+struct RawCounter {
+    static constexpr bool raw_arguments = true;
+
+    void write(const LogMessage& message) {
+        ++(message.codec != nullptr ? raw : formatted);
+    }
+
+    std::size_t raw = 0;
+    std::size_t formatted = 0;
+};
+} // namespace
+
+using SmallLogger = basic_logger<MultiThreaded, RingQueue, FileSink, RawCounter>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+// Formats as `size` characters the first time and twice as many the second time, like an argument that another
+// thread changes between the two passes.
+struct Growing {
+    std::size_t size;
+    mutable std::size_t passes = 0;
+};
+
+// Throws in the second pass.
+struct Throwing {
+    mutable std::size_t passes = 0;
+};
+} // namespace
+
+template<>
+struct std::formatter<Growing> {
+    constexpr auto parse(std::format_parse_context& context) {
+        return context.begin();
+    }
+
+    auto format(const Growing& growing, std::format_context& context) const {
+        return std::format_to(context.out(), "{}", std::string(growing.size * ++growing.passes, 'g'));
+    }
+};
+
+template<>
+struct std::formatter<Throwing> {
+    constexpr auto parse(std::format_parse_context& context) {
+        return context.begin();
+    }
+
+    auto format(const Throwing& throwing, std::format_context& context) const {
+        if (++throwing.passes == 2) {
+            throw std::runtime_error("formatter failed");
+        }
+        return std::format_to(context.out(), "thrown");
+    }
+};
+
+namespace {
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+// Number of lines holding `text`.
+std::size_t count(const std::vector<std::string>& lines, std::string_view text) {
+    return static_cast<std::size_t>(
+        std::ranges::count_if(lines, [&](const std::string& line) { return line.find(text) != std::string::npos; }));
+}
+
+std::vector<std::string> read_lines(const char* file_name) {
+    std::ifstream file(file_name);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Log records of every kind, with a backtrace, through a ring buffer of the smallest capacity. Records that do not
+// fit into it must take another way instead of waiting forever for space.
+bool test_small_queue(BackendMode backend) {
+    constexpr std::size_t COUNT = 100;
+#define MINILOG_TEST_8 "{} {} {} {} {} {} {} {} "
+#define MINILOG_TEST_64 MINILOG_TEST_8 MINILOG_TEST_8 MINILOG_TEST_8 MINILOG_TEST_8 MINILOG_TEST_8 MINILOG_TEST_8 \
+    MINILOG_TEST_8 MINILOG_TEST_8
+#define MINILOG_TEST_D8 d, d, d, d, d, d, d, d
+    auto& logger = SmallLogger::instance();
+    std::remove("test_queue_small.log");
+    logger.sink<RawCounter>() = {};
+    logger.set_queue_capacity(1);
+    logger.set_backtrace_level(LogLevel::INFO);
+    logger.initialize("test_queue_small.log", LogLevel::INFO, backend);
+    std::string text(RingBuffer::MIN_CAPACITY, 't');
+    double d = 0.5;
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        MINILOG_LOG_TO(SmallLogger::instance(), LogLevel::INFO, "Literal");
+        MINILOG_LOG_TO(SmallLogger::instance(), LogLevel::INFO, "Formatted {}", i);
+        MINILOG_LOG_TO(SmallLogger::instance(), LogLevel::INFO, "Heap {}", text);
+        // 64 doubles do not fit into the largest record of the ring buffer.
+        MINILOG_LOG_TO(SmallLogger::instance(), LogLevel::INFO, "Raw " MINILOG_TEST_64, MINILOG_TEST_D8,
+                       MINILOG_TEST_D8, MINILOG_TEST_D8, MINILOG_TEST_D8, MINILOG_TEST_D8, MINILOG_TEST_D8,
+                       MINILOG_TEST_D8, MINILOG_TEST_D8);
+    }
+#undef MINILOG_TEST_8
+#undef MINILOG_TEST_64
+#undef MINILOG_TEST_D8
+    logger.shutdown();
+    std::size_t raw = logger.sink<RawCounter>().raw;
+    std::size_t formatted = logger.sink<RawCounter>().formatted;
+
+    std::vector<std::string> lines = read_lines("test_queue_small.log");
+    bool ok = true;
+    if (count(lines, "] Literal") != COUNT || count(lines, "] Formatted ") != COUNT ||
+        count(lines, "] Heap " + text) != COUNT || count(lines, "] Raw 0.5 ") != COUNT) {
+        ok = fail("a record is lost with the smallest ring buffer");
+    }
+    // Only the integer of "Formatted {}" stays raw.
+    if (raw != COUNT || formatted != 3 * COUNT) {
+        ok = fail("a record too large for the ring buffer keeps its raw arguments");
+    }
+    return ok;
+}
+
+// Length of the message of the first line holding `text`, from `text` to the end of the line, or 0.
+std::size_t message_length(const std::vector<std::string>& lines, std::string_view text) {
+    for (const std::string& line : lines) {
+        if (std::size_t found = line.find(text); found != std::string::npos) {
+            return line.size() - found;
+        }
+    }
+    return 0;
+}
+} // namespace
+
+int main() {
+    auto& logger = TestLogger::instance();
+    std::remove("test_queue.log");
+    logger.initialize("test_queue.log", LogLevel::INFO, true);
+
+    // A record in the ring buffer, and one on the heap: larger than a quarter of the ring buffer.
+    constexpr std::size_t SMALL = 100;
+    constexpr std::size_t LARGE = 300 * 1024;
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Growing {}", Growing{SMALL});
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "After growing {}", 1);
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Large growing {}", Growing{LARGE});
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "After growing {}", 2);
+    bool thrown = false;
+    try {
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Throwing {}", Throwing{});
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "After throwing");
+    logger.flush(); // Waits forever if a reservation is not committed.
+    logger.shutdown();
+
+    std::vector<std::string> lines = read_lines("test_queue.log");
+    bool ok = true;
+    if (lines.size() != 5) {
+        ok = fail("wrong number of lines");
+    }
+    if (message_length(lines, "Growing ") != 8 + SMALL || message_length(lines, "Large growing ") != 14 + LARGE) {
+        ok = fail("a message is not cut to the size measured by the first pass");
+    }
+    if (message_length(lines, "After growing 1") == 0 || message_length(lines, "After growing 2") == 0) {
+        ok = fail("a record after a growing message is lost");
+    }
+    if (!thrown || message_length(lines, "Throwing") != 0 || message_length(lines, "After throwing") == 0) {
+        ok = fail("the exception of a formatter is not passed on, or the record after it is lost");
+    }
+    ok = test_small_queue(BackendMode::THREAD) && ok;
+    ok = test_small_queue(BackendMode::MANUAL) && ok;
+    return ok ? 0 : 1;
+}
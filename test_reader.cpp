@@ -0,0 +1,93 @@
+// Checks that Reader reads back the records of a file written by FileSink: levels, locations and messages, the
+// fractional seconds of the timestamps, multi-line records, and range() at sub-second resolution.
+#include <minilog_reader.hpp>
+
+#include <cstdio>
+#include <vector>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, RingQueue, FileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+constexpr int RECORDS = 100;
+
+RecordTime local_now() {
+    return std::chrono::zoned_time(std::chrono::current_zone(), std::chrono::system_clock::now()).get_local_time();
+}
+
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+bool check(const std::vector<RecordView>& records, RecordTime before, RecordTime after, int first_line) {
+    if (records.size() != RECORDS + 1) {
+        return fail("wrong number of records");
+    }
+    bool fraction = false;
+    for (int i = 0; i < RECORDS; ++i) {
+        const RecordView& record = records[i];
+        std::string expected = std::format("Record {}", i);
+        LogLevel level = i % 2 == 0 ? LogLevel::INFO : LogLevel::WARNING;
+        if (record.message != expected || record.level != level || !record.file.ends_with("test_reader.cpp") ||
+            record.line != static_cast<std::uint32_t>(first_line + i % 2)) {
+            return fail("record fields do not match the log statement");
+        }
+        if (record.time < before || record.time > after || (i > 0 && record.time < records[i - 1].time)) {
+            return fail("record time out of order or outside of the logging interval");
+        }
+        fraction = fraction || record.time != std::chrono::floor<std::chrono::seconds>(record.time);
+    }
+    if (!fraction) {
+        return fail("fractional seconds are lost");
+    }
+    if (records.back().message != "Multi\nline") {
+        return fail("multi-line record is split");
+    }
+    return true;
+}
+} // namespace
+
+int main() {
+    auto& logger = TestLogger::instance();
+    std::remove("test_reader.log");
+    logger.initialize("test_reader.log", LogLevel::INFO, false);
+    RecordTime before = local_now();
+    int first_line = __LINE__ + 2;
+    for (int i = 0; i < RECORDS; i += 2) {
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Record {}", i);
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::WARNING, "Record {}", i + 1);
+    }
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Multi\nline");
+    RecordTime after = local_now();
+    logger.shutdown();
+
+    Reader reader("test_reader.log");
+    std::vector<RecordView> records;
+    for (const RecordView& record : reader) {
+        records.push_back(record);
+    }
+    if (!check(records, before, after, first_line)) {
+        return 1;
+    }
+
+    // Records logged within the same second are told apart.
+    std::size_t from = RECORDS / 4;
+    std::size_t until = RECORDS * 3 / 4;
+    std::size_t expected = 0;
+    for (const RecordView& record : records) {
+        expected += record.time >= records[from].time && record.time < records[until].time;
+    }
+    std::size_t found = 0;
+    for (const RecordView& record : reader.range(records[from].time, records[until].time)) {
+        found += record.message.starts_with("Record ");
+    }
+    if (found != expected || found == 0) {
+        std::printf("FAILED: range() found %zu records instead of %zu\n", found, expected);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Checks that LOG_RT_* statements do not allocate, lock or make system calls. The hooks below replace operator new,
+// syscall() (used by std::atomic wait/notify for futexes), pthread_mutex_lock() and clock_gettime() and count the
+// calls made by the thread under test.
+#include <minilog_v2.hpp>
+
+#include <cstdarg>
+#include <cstdio>
+#include <new>
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, RealtimeRingQueue, FileSink>;
+
+namespace {
+thread_local bool watching = false;
+std::atomic<int> allocations = 0;
+std::atomic<int> syscalls = 0;
+std::atomic<int> mutex_locks = 0;
+std::atomic<int> clock_reads = 0;
+
+template<typename F>
+F next_symbol(const char* name) {
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+using syscall_type = long (*)(long, ...);
+using mutex_lock_type = int (*)(pthread_mutex_t*);
+using clock_gettime_type = int (*)(clockid_t, timespec*);
+
+syscall_type real_syscall = next_symbol<syscall_type>("syscall");
+mutex_lock_type real_mutex_lock = next_symbol<mutex_lock_type>("pthread_mutex_lock");
+clock_gettime_type real_clock_gettime = next_symbol<clock_gettime_type>("clock_gettime");
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (watching) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+extern "C" long syscall(long number, ...) {
+    if (watching) {
+        syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
+    va_list list;
+    va_start(list, number);
+    long args[6];
+    for (long& arg : args) {
+        arg = va_arg(list, long);
+    }
+    va_end(list);
+    return real_syscall(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    if (watching) {
+        mutex_locks.fetch_add(1, std::memory_order_relaxed);
+    }
+    return real_mutex_lock(mutex);
+}
+
+extern "C" int clock_gettime(clockid_t clock, timespec* time) {
+    if (watching) {
+        clock_reads.fetch_add(1, std::memory_order_relaxed);
+    }
+    return real_clock_gettime(clock, time);
+}
+
+#define MINILOG_RT_LOGGER TestLogger::instance()
+
+int main() {
+    std::remove("test_rt.log");
+    auto& logger = TestLogger::instance();
+    logger.set_queue_capacity(1 << 16);
+    logger.initialize("test_rt.log", LogLevel::INFO, true);
+    logger.set_log_level(LogLevel::INFO);
+
+    // The hooks must see what they are meant to catch, or the check below proves nothing.
+    watching = true;
+    {
+        std::mutex mutex;
+        std::lock_guard lock(mutex);
+        delete new int(0);
+        (void)std::chrono::system_clock::now();
+        (void)syscall(SYS_getpid);
+    }
+    watching = false;
+    if (allocations == 0 || mutex_locks == 0 || clock_reads == 0 || syscalls == 0) {
+        std::printf("FAILED: hooks are not active\n");
+        return 1;
+    }
+    allocations = syscalls = mutex_locks = clock_reads = 0;
+
+    constexpr int count = 100000;
+    std::thread audio([&] {
+        // Warm up: thread-local storage and the call site statics.
+        MINILOG_LOG_RT_TO(MINILOG_RT_LOGGER, LogLevel::INFO, "Warm-up {}", 0);
+        watching = true;
+        for (int i = 0; i < count; ++i) {
+            MINILOG_LOG_RT_TO(MINILOG_RT_LOGGER, LogLevel::INFO, "Block {} peak {:.3f} clipped {}", i, i * 0.001,
+                              i % 7 == 0);
+            MINILOG_LOG_RT_TO(MINILOG_RT_LOGGER, LogLevel::DEBUG, "Dropped by the level threshold {}", i);
+        }
+        watching = false;
+    });
+    audio.join();
+    logger.shutdown();
+
+    std::printf("allocations: %d, system calls: %d, mutex locks: %d, clock reads: %d, dropped: %llu\n",
+                allocations.load(), syscalls.load(), mutex_locks.load(), clock_reads.load(),
+                static_cast<unsigned long long>(logger.dropped()));
+    if (allocations != 0 || syscalls != 0 || mutex_locks != 0 || clock_reads != 0) {
+        std::printf("FAILED: real-time log statements must not allocate, lock or make system calls\n");
+        return 1;
+    }
+
+    // Every message is either written or counted as dropped.
+    std::ifstream file("test_rt.log");
+    std::size_t lines = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
+    if (lines + logger.dropped() != count + 1) {
+        std::printf("FAILED: %zu lines written\n", lines);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Checks that SegmentedFileSink rolls over to numbered segments, that seek_sequence() and seek_time() find records
+// through the indexes, and that reopening the store after a crash cuts off the torn record, drops the index entries
+// past the end and continues the numbering.
+#include <minilog_segments.hpp>
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<SingleThreaded, SyncQueue, SegmentedFileSink>;
+
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+constexpr const char* BASE = "test_segments";
+constexpr std::uint64_t RECORDS = 300;
+const auto START = std::chrono::sys_days(std::chrono::year(2025) / 1 / 1);
+
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Time of a record: one millisecond apart.
+std::int64_t record_time(std::uint64_t sequence) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>((START + std::chrono::milliseconds(sequence))
+                                                                    .time_since_epoch())
+        .count();
+}
+
+// Log records up to the given sequence number, opening the store first.
+void log_records(std::uint64_t from, std::uint64_t until) {
+    auto& logger = TestLogger::instance();
+    logger.sink<SegmentedFileSink>().set_segment_size(4096);
+    logger.sink<SegmentedFileSink>().set_index_interval(512);
+    logger.initialize(BASE, LogLevel::INFO, false);
+    logger.set_clock(&ManualClock::now);
+    for (std::uint64_t sequence = from; sequence < until; ++sequence) {
+        ManualClock::set(START + std::chrono::milliseconds(sequence));
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Record {} of the segmented store", sequence);
+    }
+    logger.shutdown();
+}
+
+// Find a record from the index entry returned by a seek, scanning its segment from there.
+bool scan(const segments::Segment& segment, segments::IndexEntry entry, std::uint64_t sequence) {
+    std::string content = read_file(segment.log);
+    std::span<const std::byte> data(reinterpret_cast<const std::byte*>(content.data()), content.size());
+    std::string expected = std::format("] Record {} of the segmented store\n", sequence);
+    std::string_view payload;
+    std::size_t next;
+    for (std::size_t offset = entry.offset; entry.sequence <= sequence; offset = next) {
+        framing::FrameStatus status = framing::parse(data, offset, payload, next);
+        if (status == framing::FrameStatus::END || status == framing::FrameStatus::INVALID) {
+            return false;
+        }
+        if (status == framing::FrameStatus::FRAME && entry.sequence++ == sequence) {
+            return payload.ends_with(expected);
+        }
+    }
+    return false;
+}
+
+// Look a record up by sequence number and by time.
+bool find(std::uint64_t sequence) {
+    std::vector<segments::Segment> found = segments::list(BASE);
+    std::optional<std::size_t> position = segments::find_segment(found, sequence);
+    if (!position) {
+        return false;
+    }
+    const segments::Segment& segment = found[*position];
+    std::vector<segments::IndexEntry> index = segments::parse_index(read_file(segment.index));
+    if (index.empty() || index.front().sequence != segment.first_sequence || index.front().offset != 0) {
+        return false;
+    }
+    segments::IndexEntry by_sequence = segments::seek_sequence(index, sequence, segment.first_sequence);
+    segments::IndexEntry by_time = segments::seek_time(index, record_time(sequence), segment.first_sequence);
+    return scan(segment, by_sequence, sequence) && scan(segment, by_time, sequence);
+}
+
+void remove_store() {
+    for (const segments::Segment& segment : segments::list(BASE)) {
+        std::filesystem::remove(segment.log);
+        std::filesystem::remove(segment.index);
+    }
+}
+
+#if defined(__linux__)
+std::size_t open_descriptors() {
+    return static_cast<std::size_t>(std::distance(std::filesystem::directory_iterator("/proc/self/fd"), {}));
+}
+#endif
+} // namespace
+
+int main() {
+    bool ok = true;
+    remove_store();
+    log_records(0, RECORDS);
+    std::vector<segments::Segment> found = segments::list(BASE);
+    if (found.size() < 4 || found.front().first_sequence != 0) {
+        ok = fail("the store is not split into segments");
+    }
+    for (std::uint64_t sequence : std::array<std::uint64_t, 5>{0, 1, 57, 150, RECORDS - 1}) {
+        if (!find(sequence)) {
+            ok = fail("a record is not found by sequence number or time");
+        }
+    }
+    for (const segments::Segment& segment : found) {
+        if (!find(segment.first_sequence) || (segment.first_sequence != 0 && !find(segment.first_sequence - 1))) {
+            ok = fail("a record next to a rollover is not found");
+        }
+    }
+
+    // A crash in the middle of a record, after its index entry was written.
+    const segments::Segment& last = found.back();
+    std::string log = read_file(last.log);
+    std::string index = read_file(last.index);
+    std::string torn;
+    framing::append_frame(torn, "lost record\n");
+    segments::append_index_entry(index, {RECORDS, record_time(RECORDS), log.size()});
+    std::ofstream(last.log, std::ios::binary | std::ios::trunc) << log << torn.substr(0, torn.size() / 2);
+    std::ofstream(last.index, std::ios::binary | std::ios::trunc) << index;
+    log_records(RECORDS, RECORDS);
+    if (TestLogger::instance().sink<SegmentedFileSink>().next_sequence() != RECORDS) {
+        ok = fail("the numbering does not continue after the last valid record");
+    }
+    if (read_file(last.log) != log || read_file(last.index).size() != index.size() - segments::INDEX_ENTRY_SIZE) {
+        ok = fail("the torn record or its index entry is kept");
+    }
+    log_records(RECORDS, RECORDS + 1);
+    if (!find(RECORDS) || !find(RECORDS - 1)) {
+        ok = fail("the numbering does not continue after the last valid record");
+    }
+
+    // A last segment that cannot be resumed.
+    std::ofstream(segments::list(BASE).back().log, std::ios::binary | std::ios::trunc) << "Plain text\n";
+#if defined(__linux__)
+    std::size_t descriptors = open_descriptors();
+#endif
+    try {
+        log_records(0, 0);
+        ok = fail("a segment that is not framed is accepted");
+    } catch (const std::runtime_error&) {
+    }
+#if defined(__linux__)
+    if (open_descriptors() != descriptors) {
+        ok = fail("the descriptors of a segment that cannot be resumed are leaked");
+    }
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Checks signal-safe logging: SignalSafeLine renders timestamps like std::format, before 1970 and on 29 February
+// included, and integer arguments like std::format; log_signal_safe() writes its line with write(2) to the log file
+// from a signal handler, and to stderr for a logger without a log file.
+#include <minilog_v2.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace minilog;
+
+using FileLogger = basic_logger<MultiThreaded, SyncQueue, FileSink>;
+using ConsoleLogger = basic_logger<SingleThreaded, SyncQueue, ConsoleSink>;
+
+namespace {
+// UTC offset of the zone set in main(): 5:30 east of UTC, without daylight saving time.
+constexpr std::int64_t UTC_OFFSET = 5 * 3600 + 30 * 60;
+
+bool fail(const std::string& what) {
+    std::printf("FAILED: %s\n", what.c_str());
+    return false;
+}
+
+std::string read_file(const char* name) {
+    std::ifstream file(name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+std::string expected_time(std::chrono::sys_seconds time) {
+    return std::format("{:%Y/%m/%d %H:%M:%S} ", time);
+}
+
+bool test_time() {
+    using namespace std::chrono;
+    bool ok = true;
+    const sys_seconds times[] = {
+        sys_days(year(1970) / 1 / 1),
+        sys_days(year(1970) / 1 / 1) - seconds(1),
+        sys_days(year(1969) / 7 / 20) + hours(20) + minutes(17) + seconds(40),
+        sys_days(year(1900) / 2 / 28) + hours(23) + minutes(59) + seconds(59),
+        sys_days(year(1904) / 2 / 29) + hours(12),
+        sys_days(year(2000) / 2 / 29),
+        sys_days(year(2024) / 2 / 29) + hours(23) + minutes(59) + seconds(59),
+        sys_days(year(2100) / 3 / 1),
+        sys_days(year(2038) / 1 / 19) + hours(3) + minutes(14) + seconds(8),
+        sys_days(year(2200) / 12 / 31) + hours(23) + minutes(59) + seconds(59),
+    };
+    for (sys_seconds time : times) {
+        details::SignalSafeLine line;
+        line.append_time(time.time_since_epoch().count());
+        if (line.view() != expected_time(time)) {
+            ok = fail(std::format("time {} rendered as \"{}\"", time.time_since_epoch().count(), line.view()));
+        }
+    }
+    return ok;
+}
+
+bool test_message() {
+    details::SignalSafeLine line;
+    const details::SignalSafeArg args[] = {details::SignalSafeArg::from(INT64_MIN),
+                                           details::SignalSafeArg::from(UINT64_MAX), details::SignalSafeArg::from(0),
+                                           details::SignalSafeArg::from(-42)};
+    line.append_message("{{min}} {}, max {:x}, {} and {}}}{}", args);
+    std::string expected = std::format("{{min}} {}, max {}, {} and {}}}", INT64_MIN, UINT64_MAX, 0, -42);
+    return line.view() == expected || fail(std::format("message rendered as \"{}\"", line.view()));
+}
+
+constexpr std::uint32_t SIGNAL_LINE = __LINE__ + 2;
+void handle_signal(int signal) {
+    MINILOG_LOG_SIGNAL_SAFE_TO(FileLogger::instance(), LogLevel::WARNING, "Got signal {} at depth {}", signal, -3);
+}
+
+// The line logged by handle_signal(), at a time between `before` and `after`.
+bool check_line(const std::string& line, std::chrono::sys_seconds before, std::chrono::sys_seconds after,
+                const std::string& message, std::uint32_t source_line) {
+    std::string rest = std::format("[WARNING] [{}:{}] {}\n", __FILE__, source_line, message);
+    auto local = [](std::chrono::sys_seconds time) { return expected_time(time + std::chrono::seconds(UTC_OFFSET)); };
+    return line == local(before) + rest || line == local(after) + rest;
+}
+
+std::chrono::sys_seconds now() {
+    return std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::system_clock::now());
+}
+
+bool test_file() {
+    auto& logger = FileLogger::instance();
+    std::remove("test_signal_safe.log");
+    logger.initialize("test_signal_safe.log", LogLevel::INFO, false);
+    std::signal(SIGUSR1, handle_signal);
+    std::chrono::sys_seconds before = now();
+    std::raise(SIGUSR1);
+    std::chrono::sys_seconds after = now();
+    std::signal(SIGUSR1, SIG_DFL);
+    logger.shutdown();
+
+    std::string line = read_file("test_signal_safe.log");
+    return check_line(line, before, after, std::format("Got signal {} at depth -3", SIGUSR1), SIGNAL_LINE) ||
+           fail("wrong line in the log file: " + line);
+}
+
+bool test_stderr() {
+    auto& logger = ConsoleLogger::instance();
+    std::remove("test_signal_safe.err");
+    int file = ::open("test_signal_safe.err", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int saved = ::dup(STDERR_FILENO);
+    ::dup2(file, STDERR_FILENO);
+    logger.initialize("test_signal_safe.err", LogLevel::INFO, false);
+    std::chrono::sys_seconds before = now();
+    const std::uint32_t source_line = __LINE__ + 1;
+    MINILOG_LOG_SIGNAL_SAFE_TO(logger, LogLevel::WARNING, "No log file, {} line", 1u);
+    std::chrono::sys_seconds after = now();
+    logger.shutdown();
+    ::dup2(saved, STDERR_FILENO);
+    ::close(saved);
+    ::close(file);
+
+    std::string line = read_file("test_signal_safe.err");
+    return check_line(line, before, after, "No log file, 1 line", source_line) ||
+           fail("wrong line on stderr: " + line);
+}
+} // namespace
+
+int main() {
+    // A zone without daylight saving time, set before anything reads the local time zone.
+    ::setenv("TZ", "XST-5:30", 1);
+    ::tzset();
+
+    bool ok = test_time();
+    ok = test_message() && ok;
+    ok = test_file() && ok;
+    ok = test_stderr() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// Checks the Drain template miner: messages with the same words but the variables are merged into one template, other
+// messages start their own, and the maximum number of templates holds. Then checks the summaries of SummarySink with a
+// manual clock, byte for byte: the counts, totals and examples per template, the summary written at shutdown with the
+// logger clock, and that a template without records for a whole interval is forgotten.
+#include <minilog_summary.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, SyncQueue, SummarySink>;
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+bool fail(const char* what) {
+    std::printf("FAILED: %s\n", what);
+    return false;
+}
+
+bool test_miner() {
+    bool ok = true;
+    TemplateMiner miner;
+    std::size_t request = miner.add("Request 8812 served in 3 ms");
+    if (miner.add("Request 17 served in 12 ms") != request) {
+        ok = fail("messages differing in their variables were not merged");
+    }
+    if (miner.text(request) != "Request <*> served in <*> ms") {
+        ok = fail("wrong merged template");
+    }
+    std::size_t lost = miner.add("Connection to db1 lost");
+    if (miner.add("Connection to db2 lost") != lost || miner.text(lost) != "Connection to <*> lost") {
+        ok = fail("a word without digits that differs did not become a variable");
+    }
+    if (miner.add("Request 5 served from cache") == request || miner.add("Cache miss for key 7") == lost) {
+        ok = fail("messages with other words or another word count joined a template");
+    }
+    if (miner.size() != 4) {
+        ok = fail("wrong number of templates");
+    }
+
+    TemplateMiner small;
+    small.set_max_templates(2);
+    std::size_t first = small.add("Disk full on sda");
+    small.add("Fan speed 1200 rpm");
+    if (small.add("Battery at 42 percent now") != TemplateMiner::OTHER) {
+        ok = fail("a template was started past the maximum");
+    }
+    if (small.add("Disk full on sdb") != first) {
+        ok = fail("a message matching a template was not merged when the miner is full");
+    }
+    small.remove(first);
+    if (small.add("Battery at 42 percent now") != first || small.size() != 2) {
+        ok = fail("the index of a removed template was not reused");
+    }
+    return ok;
+}
+
+std::string timestamp(std::chrono::system_clock::time_point time) {
+    return std::format("{:%Y/%m/%d %H:%M:%S} ", std::chrono::zoned_time(std::chrono::current_zone(), time));
+}
+
+std::string read_file(const char* name) {
+    std::ifstream file(name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+bool test_sink() {
+    auto& logger = TestLogger::instance();
+    std::remove("test_summary.log");
+    SummarySink& sink = logger.sink<SummarySink>();
+    sink.set_grouping(Grouping::TEMPLATE);
+    sink.set_interval(std::chrono::seconds(60));
+    logger.initialize("test_summary.log", LogLevel::INFO, false);
+    logger.set_clock(&ManualClock::now);
+
+    auto start = std::chrono::sys_days(std::chrono::year(2025) / 3 / 1) + std::chrono::hours(9);
+    ManualClock::set(start);
+    const std::uint32_t request_line = __LINE__ + 2;
+    for (auto [id, ms] : {std::pair{8812, 3}, std::pair{17, 12}}) {
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Request {} served in {} ms", id, ms);
+    }
+    const std::uint32_t cache_line = __LINE__ + 1;
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::WARNING, "Cache miss for key {}", 7);
+    const std::uint32_t lost_line = __LINE__ + 2;
+    for (const char* message : {"Connection to db1 lost", "Connection to db2 lost", "Connection to db3 lost"}) {
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::ERROR, "{}", std::string(message));
+        // The third record is the first of the second interval and writes the summary of the first one.
+        ManualClock::advance(std::chrono::seconds(30));
+    }
+    logger.shutdown();
+
+    // The request and cache templates had no records in the second interval, so only the connection one is left.
+    bool ok = true;
+    if (sink.miner().size() != 1) {
+        ok = fail("idle templates were not forgotten");
+    }
+    std::string first = timestamp(start + std::chrono::seconds(60));
+    std::string second = timestamp(start + std::chrono::seconds(90));
+    std::string expected =
+        first + std::format("[INFO] [{}:{}] 2 x \"Request <*> served in <*> ms\" (2 in total)\n", __FILE__,
+                            request_line) +
+        "    Request 8812 served in 3 ms\n    Request 17 served in 12 ms\n" + first +
+        std::format("[WARNING] [{}:{}] 1 x \"Cache miss for key 7\" (1 in total)\n", __FILE__, cache_line) +
+        "    Cache miss for key 7\n" + first +
+        std::format("[ERROR] [{}:{}] 2 x \"Connection to <*> lost\" (2 in total)\n", __FILE__, lost_line) +
+        "    Connection to db1 lost\n    Connection to db2 lost\n" + second +
+        std::format("[ERROR] [{}:{}] 1 x \"Connection to <*> lost\" (3 in total)\n", __FILE__, lost_line) +
+        "    Connection to db3 lost\n";
+    std::string actual = read_file("test_summary.log");
+    if (actual != expected) {
+        std::printf("Expected:\n%sActual:\n%s", expected.c_str(), actual.c_str());
+        ok = fail("wrong summaries");
+    }
+    return ok;
+}
+} // namespace
+
+int main() {
+    bool ok = test_miner();
+    ok = test_sink() && ok;
+    return ok ? 0 : 1;
+}
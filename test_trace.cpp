@@ -0,0 +1,134 @@
+// Checks trace sampling: sequential trace ids, which only differ in their last bits, and ids which only differ in
+// their high half are sampled at the requested ratio, the decision is the same for the same id, and ratios of 0 and 1
+// sample nothing and everything. Then checks that scoped_trace_context writes the trace prefix and raises the
+// verbosity of the thread for a sampled trace only, and restores both when it ends.
+#include <minilog_v2.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace minilog;
+
+using TestLogger = basic_logger<MultiThreaded, SyncQueue, FileSink>;
+#define MINILOG_TEST_LOGGER TestLogger::instance()
+
+namespace {
+bool fail(const std::string& what) {
+    std::printf("FAILED: %s\n", what.c_str());
+    return false;
+}
+
+std::string read_file(const char* name) {
+    std::ifstream file(name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+constexpr std::uint64_t TRACES = 100000;
+
+// Fraction of the traces sampled among TRACES ids made by `make`.
+template<typename Make>
+double sampled_fraction(Make make) {
+    std::uint64_t sampled = 0;
+    for (std::uint64_t i = 0; i < TRACES; ++i) {
+        sampled += is_trace_sampled(make(i));
+    }
+    return static_cast<double>(sampled) / TRACES;
+}
+
+bool test_sampling() {
+    bool ok = true;
+    auto sequential = [](std::uint64_t i) { return TraceContext{0x0af7651916cd43dd, i + 1, 1}; };
+    auto high = [](std::uint64_t i) { return TraceContext{i + 1, 0x8448eb211c80319c, 1}; };
+    for (double ratio : {0.01, 0.25, 0.5}) {
+        set_trace_sampling(ratio);
+        for (double fraction : {sampled_fraction(sequential), sampled_fraction(high)}) {
+            // Within 10%: at least 3 standard deviations of a binomial distribution at these ratios.
+            if (fraction < ratio * 0.9 || fraction > ratio * 1.1) {
+                ok = fail(std::format("{} of the traces sampled for a ratio of {}", fraction, ratio));
+            }
+        }
+    }
+    set_trace_sampling(0.25);
+    TraceContext context{0x4bf92f3577b34da6, 0xa3ce929d0e0e4736, 0x00f067aa0ba902b7};
+    bool decision = is_trace_sampled(context);
+    for (int i = 0; i < 10; ++i) {
+        if (is_trace_sampled(context) != decision) {
+            ok = fail("the decision changed for the same trace id");
+        }
+    }
+    set_trace_sampling(0.0);
+    if (sampled_fraction(sequential) != 0.0) {
+        ok = fail("traces sampled with sampling disabled");
+    }
+    set_trace_sampling(1.0);
+    if (sampled_fraction(sequential) != 1.0 || sampled_fraction(high) != 1.0) {
+        ok = fail("not every trace sampled for a ratio of 1");
+    }
+    return ok;
+}
+
+// First of 1000 sequential trace ids whose sampling decision is `sampled`, or the last one.
+TraceContext find_trace(bool sampled) {
+    TraceContext context{0x0123456789abcdef, 1, 0x1122334455667788};
+    while (context.trace_id_low < 1000 && is_trace_sampled(context) != sampled) {
+        ++context.trace_id_low;
+    }
+    return context;
+}
+
+bool test_scoped_context() {
+    auto& logger = TestLogger::instance();
+    std::remove("test_trace.log");
+    logger.initialize("test_trace.log", LogLevel::INFO, false);
+    logger.set_log_level(LogLevel::INFO);
+    set_trace_sampling(0.5, LogLevel::DEBUG);
+    TraceContext sampled = find_trace(true);
+    TraceContext skipped = find_trace(false);
+    bool ok = true;
+    if (!is_trace_sampled(sampled) || is_trace_sampled(skipped)) {
+        ok = fail("no sampled and unsampled trace among 1000 sequential ids");
+    }
+    {
+        scoped_trace_context guard(sampled);
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::DEBUG, "Sampled debug");
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::TRACE, "Sampled trace");
+    }
+    {
+        scoped_trace_context guard(skipped);
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::DEBUG, "Skipped debug");
+        MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "Skipped info");
+    }
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::DEBUG, "No trace debug");
+    MINILOG_LOG_TO(MINILOG_TEST_LOGGER, LogLevel::INFO, "No trace info");
+    logger.shutdown();
+    set_trace_sampling(0.0);
+
+    auto prefix = [](const TraceContext& context) {
+        return std::format("[{:016x}{:016x}:{:016x}] ", context.trace_id_high, context.trace_id_low, context.span_id);
+    };
+    std::string log = read_file("test_trace.log");
+    if (log.find("] " + prefix(sampled) + "Sampled debug\n") == std::string::npos) {
+        ok = fail("the debug message of a sampled trace is missing or has no trace prefix");
+    }
+    if (log.find("] " + prefix(skipped) + "Skipped info\n") == std::string::npos) {
+        ok = fail("the info message of a trace that is not sampled is missing or has no trace prefix");
+    }
+    if (log.find("Sampled trace") != std::string::npos || log.find("Skipped debug") != std::string::npos ||
+        log.find("No trace debug") != std::string::npos) {
+        ok = fail("a message below the level of its thread was written");
+    }
+    if (log.find("] No trace info\n") == std::string::npos) {
+        ok = fail("a message after the trace context ended has a trace prefix");
+    }
+    return ok;
+}
+} // namespace
+
+int main() {
+    bool ok = test_sampling();
+    ok = test_scoped_context() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Checks that a file written by ZstdFileSink decompresses to the text FileSink writes for the same records, with
+// small blocks of several lines written by a backend and a dictionary trained part way through the file.
+#include <minilog_zstd.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static_assert(MINILOG_HAS_ZSTD, "test_zstd needs the zstd headers");
+
+using namespace minilog;
+
+// Both loggers log the same statements with the same manual clock. The compressed one writes batches of records with
+// the manual backend, so that the blocks do not depend on the timing of a backend thread.
+using CompressedLogger = basic_logger<MultiThreaded, RingQueue, ZstdFileSink>;
+using TextLogger = basic_logger<SingleThreaded, SyncQueue, FileSink>;
+
+namespace {
+constexpr int RECORDS = 2000;
+constexpr int BATCH = 100;
+
+template<typename Logger>
+void log_record(Logger& logger, int i) {
+    MINILOG_LOG_TO(logger, LogLevel::INFO, "Order {} filled at {:.2f} for account {}", i, i * 0.25, i % 7);
+    if (i % 10 == 0) {
+        MINILOG_LOG_TO(logger, LogLevel::WARNING, "Gateway {} is slow: {} ms", i % 3, i / 10);
+    }
+}
+
+std::string read_file(const char* name) {
+    std::ifstream file(name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Number of BLOCK entries of a compressed file.
+std::size_t count_blocks(std::string_view data) {
+    std::size_t blocks = 0;
+    while (data.size() >= zstd::ENTRY_HEADER_SIZE) {
+        std::uint32_t size = 0;
+        for (int i = 3; i >= 0; --i) {
+            size = size << 8 | static_cast<unsigned char>(data[1 + i]);
+        }
+        blocks += data[0] == zstd::BLOCK;
+        data.remove_prefix(std::min<std::size_t>(data.size(), zstd::ENTRY_HEADER_SIZE + size));
+    }
+    return blocks;
+}
+} // namespace
+
+int main() {
+    std::remove("test_zstd.log.zst");
+    std::remove("test_zstd.log");
+    auto& compressed = CompressedLogger::instance();
+    auto& text = TextLogger::instance();
+    compressed.sink<ZstdFileSink>().set_block_size(512);
+    compressed.sink<ZstdFileSink>().set_dictionary_training(32 * 1024, 4 * 1024);
+    compressed.initialize("test_zstd.log.zst", LogLevel::INFO, BackendMode::MANUAL);
+    text.initialize("test_zstd.log", LogLevel::INFO, false);
+    compressed.set_clock(&ManualClock::now);
+    text.set_clock(&ManualClock::now);
+
+    ManualClock::set(std::chrono::sys_days(std::chrono::year(2025) / 1 / 1));
+    for (int i = 0; i < RECORDS; ++i) {
+        log_record(compressed, i);
+        log_record(text, i);
+        ManualClock::advance(std::chrono::microseconds(1250));
+        if ((i + 1) % BATCH == 0) {
+            compressed.poll();
+        }
+    }
+    compressed.shutdown();
+    text.shutdown();
+    bool trained = !compressed.sink<ZstdFileSink>().dictionary().empty();
+
+    std::string expected = read_file("test_zstd.log");
+    std::string data = read_file("test_zstd.log.zst");
+    std::string restored = zstd::decompress(data);
+    std::printf("%zu bytes of text compressed to %zu bytes\n", expected.size(), data.size());
+    if (!trained) {
+        std::printf("FAILED: no dictionary was trained\n");
+        return 1;
+    }
+    if (restored != expected) {
+        std::printf("FAILED: the decompressed text differs from the text written by FileSink\n");
+        return 1;
+    }
+    // Blocks of 512 bytes hold several lines of about 80 bytes, unless every line is flushed on its own.
+    auto lines = static_cast<std::size_t>(std::ranges::count(expected, '\n'));
+    if (count_blocks(data) * 3 > lines) {
+        std::printf("FAILED: %zu blocks for %zu lines\n", count_blocks(data), lines);
+        return 1;
+    }
+    return 0;
+}